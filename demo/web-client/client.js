@@ -3,11 +3,37 @@ let playerId = null;
 let isConnected = false;
 let pingInterval = null;
 let lastPingTime = 0;
+let lastLatency = -1; // Reported with each ping; the server matches players by latency
+
+// Session resumption: after a dropped connection we reconnect and present the token
+// to get our player, match seat and state back
+const MAX_RESUME_ATTEMPTS = 5;
+let reconnectToken = null;
+let resumeAttempts = 0;
+let resuming = false;
+let userDisconnected = false;
+let pendingIdentity = null; // The new connection's own ID, used if the resume fails
 
 // Optimized State Management
 let playerElements = {}; // Map<playerId, DOMElement>
 let localPlayerPos = { x: 0, y: 0 }; // Local prediction state
 
+// Binary state protocol ("game-binary", see server/StateCodec.h)
+const STATE_DELTA = 1;
+const STATE_ACK = 2;
+let stateHistory = new Map(); // tick -> { players, projectiles }, baselines the server may send deltas against
+let lastServerTick = 0; // Sent with actions so the server can rewind to what we saw
+let chatSeen = {}; // channel -> { liveFrom, through }: chat sequence numbers already shown
+
+// Input batching: actions made during a frame go out together as one game_actions
+// message, preceded by the last few already sent so a dropped input is covered
+const REDUNDANT_ACTIONS = 2;
+const MAX_BATCH_ACTIONS = 16; // Server limit per message
+let sequenceNumber = 0;
+let pendingActions = [];
+let recentActions = [];
+let flushScheduled = false;
+
 // Colors for players (Grayscale/Monochrome)
 const PLAYER_COLORS = [
     '#ffffff', '#dddddd', '#bbbbbb', '#999999', 
@@ -54,6 +80,9 @@ function connect() {
     const url = document.getElementById('serverUrl').value;
     if (!url) return;
     
+    userDisconnected = false;
+    resuming = false;
+    reconnectToken = null;
     if (ws) {
         ws.close();
         ws = null;
@@ -68,7 +97,9 @@ function createWebSocketConnection(url) {
         if (url.startsWith('wss://')) url = url.replace('wss://', 'ws://');
         
         // log('Attempting to connect to: ' + url, 'info'); // Removed
-        ws = new WebSocket(url);
+        ws = new WebSocket(url, ['game-binary', 'game-websocket']);
+        ws.binaryType = 'arraybuffer';
+        const socket = ws;
         
         ws.onopen = () => {
             // log('Connected to server', 'success'); // Removed, waiting for ID
@@ -76,16 +107,26 @@ function createWebSocketConnection(url) {
             pingInterval = setInterval(() => {
                 if (ws && ws.readyState === WebSocket.OPEN) {
                     lastPingTime = Date.now();
-                    sendMessage({ type: 'ping' });
+                    sendMessage({ type: 'ping', latency: lastLatency });
                 }
             }, 5000);
             initGrid();
         };
         
         ws.onclose = (event) => {
-            log('Disconnected', 'warning');
+            if (ws !== socket) return; // Replaced by a newer connection
             updateStatus(false);
             if (pingInterval) clearInterval(pingInterval);
+            
+            // Keep state history: the server resumes with a delta against our last tick
+            if (!userDisconnected && reconnectToken && resumeAttempts < MAX_RESUME_ATTEMPTS) {
+                resumeAttempts++;
+                resuming = true;
+                log(`Connection lost, resuming session (attempt ${resumeAttempts})...`, 'warning');
+                setTimeout(() => createWebSocketConnection(url), 1000 * resumeAttempts);
+                return;
+            }
+            log('Disconnected', 'warning');
             resetGame();
         };
         
@@ -95,7 +136,11 @@ function createWebSocketConnection(url) {
         
         ws.onmessage = (event) => {
             try {
-                handleMessage(JSON.parse(event.data));
+                if (typeof event.data === 'string') {
+                    handleMessage(JSON.parse(event.data));
+                } else {
+                    handleBinaryMessage(event.data);
+                }
             } catch (e) { }
         };
     } catch (e) {
@@ -104,6 +149,8 @@ function createWebSocketConnection(url) {
 }
 
 function disconnect() {
+    userDisconnected = true;
+    reconnectToken = null;
     if (ws) ws.close();
     updateStatus(false);
     resetGame();
@@ -115,19 +162,145 @@ function sendMessage(message) {
     }
 }
 
+function queueAction(action) {
+    action.sequenceNumber = ++sequenceNumber;
+    pendingActions.push(action);
+    if (pendingActions.length + REDUNDANT_ACTIONS >= MAX_BATCH_ACTIONS) {
+        flushActions();
+    } else if (!flushScheduled) {
+        flushScheduled = true;
+        requestAnimationFrame(flushActions);
+    }
+}
+
+function flushActions() {
+    flushScheduled = false;
+    if (pendingActions.length === 0) return;
+    
+    sendMessage({ type: 'game_actions', tick: lastServerTick, actions: recentActions.concat(pendingActions) });
+    recentActions = recentActions.concat(pendingActions).slice(-REDUNDANT_ACTIONS);
+    pendingActions = [];
+}
+
+function readVarint(bytes, pos) {
+    let value = 0, scale = 1, b;
+    do {
+        b = bytes[pos.offset++];
+        value += (b & 0x7f) * scale;
+        scale *= 128;
+    } while (b & 0x80);
+    return value;
+}
+
+function readZigzag(bytes, pos) {
+    const v = readVarint(bytes, pos);
+    return (v % 2 === 0) ? v / 2 : -(v + 1) / 2;
+}
+
+function writeVarint(out, value) {
+    while (value >= 0x80) {
+        out.push((value % 128) | 0x80);
+        value = Math.floor(value / 128);
+    }
+    out.push(value);
+}
+
+function handleBinaryMessage(buffer) {
+    const bytes = new Uint8Array(buffer);
+    if (bytes[0] !== STATE_DELTA) return;
+    
+    const pos = { offset: 1 };
+    const tick = readVarint(bytes, pos);
+    const serverTime = readVarint(bytes, pos);
+    const baseTick = readVarint(bytes, pos);
+    
+    const base = baseTick === 0 ? { players: {}, projectiles: {} } : stateHistory.get(baseTick);
+    if (!base) return; // Baseline no longer held; the server falls back to a full state
+    
+    const players = Object.assign({}, base.players);
+    const upserts = readVarint(bytes, pos);
+    for (let i = 0; i < upserts; i++) {
+        const id = readVarint(bytes, pos);
+        const x = readZigzag(bytes, pos);
+        const y = readZigzag(bytes, pos);
+        players[id] = { x, y };
+    }
+    const removals = readVarint(bytes, pos);
+    for (let i = 0; i < removals; i++) {
+        delete players[readVarint(bytes, pos)];
+    }
+    
+    // Keyed by entity ID, which the server reuses; an upsert replaces what we held
+    const projectiles = Object.assign({}, base.projectiles);
+    const projectileUpserts = readVarint(bytes, pos);
+    for (let i = 0; i < projectileUpserts; i++) {
+        const id = readVarint(bytes, pos);
+        const ownerId = readVarint(bytes, pos);
+        const x = readZigzag(bytes, pos);
+        const y = readZigzag(bytes, pos);
+        projectiles[id] = { id, type: 'projectile', ownerId, x, y };
+    }
+    const projectileRemovals = readVarint(bytes, pos);
+    for (let i = 0; i < projectileRemovals; i++) {
+        delete projectiles[readVarint(bytes, pos)];
+    }
+    
+    // Later deltas are never based on anything older than this baseline
+    stateHistory.set(tick, { players, projectiles });
+    for (const t of stateHistory.keys()) {
+        if (t < baseTick) stateHistory.delete(t);
+    }
+    
+    const ack = [STATE_ACK];
+    writeVarint(ack, tick);
+    if (ws && ws.readyState === WebSocket.OPEN) ws.send(new Uint8Array(ack));
+    
+    const entities = Object.values(projectiles);
+    handleMessage({ type: 'state_update', tick, serverTime, state: { players, entities } });
+}
+
 function handleMessage(message) {
     switch (message.type) {
         case 'connected':
+            if (resuming && reconnectToken) {
+                pendingIdentity = message;
+                const lastTick = stateHistory.has(lastServerTick) ? lastServerTick : 0;
+                sendMessage({ type: 'resume', token: reconnectToken, lastTick });
+                break;
+            }
             playerId = message.playerId;
+            reconnectToken = message.reconnectToken || null;
             document.getElementById('playerId').textContent = playerId || '-';
             log(`Connected to server as Player ${playerId}`, 'success');
             break;
+        case 'resumed':
+            playerId = message.playerId;
+            reconnectToken = message.reconnectToken || null;
+            resuming = false;
+            resumeAttempts = 0;
+            document.getElementById('playerId').textContent = playerId || '-';
+            log(`Resumed session as Player ${playerId}`, 'success');
+            break;
+        case 'resume_failed':
+            // Grace period over; carry on as the new connection's player
+            resuming = false;
+            resumeAttempts = 0;
+            resetGame();
+            playerId = pendingIdentity ? pendingIdentity.playerId : null;
+            reconnectToken = pendingIdentity ? pendingIdentity.reconnectToken || null : null;
+            document.getElementById('playerId').textContent = playerId || '-';
+            log(`Could not resume session; connected as Player ${playerId}`, 'warning');
+            break;
         case 'match_found':
             log(`Match Found!`, 'match');
             break;
         case 'chat_message':
             log(`[${message.channel}] ${message.username || 'Unknown'}: ${message.message}`, 'chat');
             break;
+        case 'chat_batch':
+        case 'chat_history':
+            unseenChatMessages(message).forEach(m => log(`[${message.channel}] ${m.username || 'Unknown'}: ${m.message}`, 'chat'));
+            break;
         case 'state_update':
             // Show current time in EST (HH:MM:SS format)
             const now = new Date();
@@ -139,7 +312,11 @@ function handleMessage(message) {
             handleStateUpdate(message);
             break;
         case 'pong':
-            document.getElementById('latency').textContent = Date.now() - lastPingTime;
+            lastLatency = Date.now() - lastPingTime;
+            document.getElementById('latency').textContent = lastLatency;
+            break;
+        case 'player_hit':
+            log(`Player ${message.shooterId} hit Player ${message.targetId}`, 'info');
             break;
     }
 }
@@ -208,18 +385,38 @@ function initGrid() {
     }
 }
 
+// A live batch can arrive just before the join replay that repeats it (and a resume
+// replays what we already showed); drop replayed messages we have seen live
+function unseenChatMessages(message) {
+    const seen = chatSeen[message.channel] || (chatSeen[message.channel] = { liveFrom: 0, through: 0 });
+    const live = message.type === 'chat_batch';
+    return (message.messages || []).filter(m => {
+        if (m.seq === undefined) return true;
+        const duplicate = live ? m.seq <= seen.through
+                               : seen.liveFrom > 0 && m.seq >= seen.liveFrom && m.seq <= seen.through;
+        if (live && seen.liveFrom === 0) seen.liveFrom = m.seq;
+        seen.through = Math.max(seen.through, m.seq);
+        return !duplicate;
+    });
+}
+
 function resetGame() {
     playerElements = {};
+    chatSeen = {};
+    stateHistory.clear();
+    lastServerTick = 0;
+    pendingActions = [];
+    recentActions = [];
     const cells = document.querySelectorAll('.grid-cell');
     cells.forEach(c => c.innerHTML = '');
 }
 
 function joinGame() {
-    sendMessage({
-        type: 'game_action',
+    queueAction({
         actionType: 'spawn',
         actionId: Date.now(),
-        timestamp: Date.now()
+        timestamp: Date.now(),
+        tick: lastServerTick
     });
     log('Joining game...', 'info');
     isGameFocused = true;
@@ -260,16 +457,17 @@ function handleKeyPress(e) {
         }
     }
 
-    sendMessage({
-        type: 'game_action',
+    queueAction({
         actionType: action,
         actionId: now,
         timestamp: now,
+        tick: lastServerTick,
         data: data
     });
 }
 
 function handleStateUpdate(message) {
+    if (message.tick > lastServerTick) lastServerTick = message.tick;
     if (!message.state || !message.state.players) return;
     const players = message.state.players;
     
@@ -1,4 +1,5 @@
 using System;
+using Newtonsoft.Json;
 
 namespace GameServerSDK
 {
@@ -27,6 +28,12 @@ namespace GameServerSDK
         public string? Message { get; set; }
         public ulong Timestamp { get; set; }
         public string? Channel { get; set; }
+
+        /// <summary>
+        /// Position in the channel's history, from 1 (0 for single chat_message events)
+        /// </summary>
+        [JsonProperty("seq")]
+        public ulong Sequence { get; set; }
     }
 
     public class StateUpdateEventArgs : EventArgs
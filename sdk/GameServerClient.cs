@@ -1,4 +1,7 @@
 using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.IO;
 using System.Net.WebSockets;
 using System.Text;
 using System.Threading;
@@ -20,6 +23,25 @@ namespace GameServerSDK
         private bool _isConnected;
         private ulong _playerId;
         private ulong _sequenceNumber;
+        private ulong _lastServerTick; // Sent with actions so the server can rewind to what we saw
+        private long _pingSentAt;
+        private double _latency = -1; // Reported with each ping; the server matches players by latency
+        private readonly StateDeltaDecoder _stateDecoder = new StateDeltaDecoder();
+        private string? _reconnectToken;
+        private bool _resuming;
+        private JObject? _pendingIdentity; // The new connection's own "connected" message while resuming
+        private readonly Dictionary<string, (ulong LiveFrom, ulong Through)> _chatSeen = new(); // Chat sequence numbers already raised, per channel
+        private readonly SemaphoreSlim _sendLock = new SemaphoreSlim(1, 1); // ClientWebSocket allows one send at a time
+
+        // Input batching: actions made within a frame go out as one game_actions message,
+        // preceded by the last few already sent so a dropped input is covered by the next batch
+        private const int RedundantActions = 2;
+        private const int MaxBatchActions = 16; // Server limit per message
+        private static readonly TimeSpan ActionBatchInterval = TimeSpan.FromMilliseconds(16);
+        private readonly object _actionLock = new object();
+        private readonly List<object> _pendingActions = new List<object>();
+        private readonly Queue<object> _recentActions = new Queue<object>();
+        private Task? _flushTask;
 
         // Events
         public event EventHandler<ConnectedEventArgs>? OnConnected;
@@ -32,6 +54,16 @@ namespace GameServerSDK
         public bool IsConnected => _isConnected && _webSocket?.State == WebSocketState.Open;
         public ulong PlayerId => _playerId;
 
+        /// <summary>
+        /// Round trip of the last answered ping in milliseconds, or -1 before the first pong
+        /// </summary>
+        public double Latency => _latency;
+
+        /// <summary>
+        /// Token for resuming this session after a dropped connection, or null if the server doesn't offer it
+        /// </summary>
+        public string? ReconnectToken => _reconnectToken;
+
         public GameServerClient(string serverUrl = "ws://localhost:8080")
         {
             _serverUrl = serverUrl;
@@ -41,7 +73,34 @@ namespace GameServerSDK
         /// <summary>
         /// Connects to the game server
         /// </summary>
-        public async Task ConnectAsync(CancellationToken cancellationToken = default)
+        public Task ConnectAsync(CancellationToken cancellationToken = default)
+        {
+            _resuming = false;
+            _stateDecoder.Reset();
+            _chatSeen.Clear();
+            ClearActions();
+            return OpenAsync(cancellationToken);
+        }
+
+        /// <summary>
+        /// Reconnects after a dropped connection and takes back the previous player, match seat
+        /// and state. The server answers with a delta against the last state received; if the
+        /// session has expired, the client continues as the new connection's player.
+        /// </summary>
+        public Task ResumeAsync(CancellationToken cancellationToken = default)
+        {
+            if (_reconnectToken == null)
+            {
+                throw new InvalidOperationException("No session to resume");
+            }
+
+            _resuming = true;
+            _webSocket?.Dispose();
+            _webSocket = null;
+            return OpenAsync(cancellationToken);
+        }
+
+        private async Task OpenAsync(CancellationToken cancellationToken)
         {
             if (_isConnected)
             {
@@ -49,6 +108,8 @@ namespace GameServerSDK
             }
 
             _webSocket = new ClientWebSocket();
+            _webSocket.Options.AddSubProtocol("game-binary");
+            _webSocket.Options.AddSubProtocol("game-websocket");
             _cancellationTokenSource = new CancellationTokenSource();
 
             try
@@ -79,6 +140,7 @@ namespace GameServerSDK
             }
 
             _isConnected = false;
+            _reconnectToken = null;
             _cancellationTokenSource?.Cancel();
 
             if (_webSocket != null && _webSocket.State == WebSocketState.Open)
@@ -100,6 +162,7 @@ namespace GameServerSDK
         private async Task ReceiveLoopAsync(CancellationToken cancellationToken)
         {
             var buffer = new byte[4096];
+            using var messageBuffer = new MemoryStream();
 
             while (!cancellationToken.IsCancellationRequested && _webSocket?.State == WebSocketState.Open)
             {
@@ -113,10 +176,22 @@ namespace GameServerSDK
                         break;
                     }
 
+                    messageBuffer.Write(buffer, 0, result.Count);
+                    if (!result.EndOfMessage)
+                    {
+                        continue;
+                    }
+
+                    var payload = messageBuffer.ToArray();
+                    messageBuffer.SetLength(0);
+
                     if (result.MessageType == WebSocketMessageType.Text)
                     {
-                        var message = Encoding.UTF8.GetString(buffer, 0, result.Count);
-                        HandleMessage(message);
+                        HandleMessage(Encoding.UTF8.GetString(payload));
+                    }
+                    else if (result.MessageType == WebSocketMessageType.Binary)
+                    {
+                        await HandleBinaryMessageAsync(payload);
                     }
                 }
                 catch (OperationCanceledException)
@@ -143,7 +218,35 @@ namespace GameServerSDK
                 switch (type)
                 {
                     case "connected":
+                        if (_resuming)
+                        {
+                            _pendingIdentity = json;
+                            var lastTick = _stateDecoder.HasBaseline(_lastServerTick) ? _lastServerTick : 0;
+                            _ = SendMessageAsync(new { type = "resume", token = _reconnectToken, lastTick = lastTick });
+                            break;
+                        }
+                        _playerId = json["playerId"]?.ToObject<ulong>() ?? 0;
+                        _reconnectToken = json["reconnectToken"]?.ToString();
+                        OnConnected?.Invoke(this, new ConnectedEventArgs { PlayerId = _playerId });
+                        break;
+
+                    case "resumed":
+                        _resuming = false;
                         _playerId = json["playerId"]?.ToObject<ulong>() ?? 0;
+                        _reconnectToken = json["reconnectToken"]?.ToString();
+                        OnConnected?.Invoke(this, new ConnectedEventArgs { PlayerId = _playerId });
+                        break;
+
+                    case "resume_failed":
+                        // Session expired; carry on as the new connection's player
+                        _resuming = false;
+                        _playerId = _pendingIdentity?["playerId"]?.ToObject<ulong>() ?? 0;
+                        _reconnectToken = _pendingIdentity?["reconnectToken"]?.ToString();
+                        _lastServerTick = 0;
+                        _stateDecoder.Reset();
+                        _chatSeen.Clear();
+                        ClearActions();
+                        OnError?.Invoke(this, new ErrorEventArgs { Message = "Session could not be resumed" });
                         OnConnected?.Invoke(this, new ConnectedEventArgs { PlayerId = _playerId });
                         break;
 
@@ -157,13 +260,35 @@ namespace GameServerSDK
                         OnChatMessage?.Invoke(this, chatMsg ?? new ChatMessageEventArgs());
                         break;
 
+                    case "chat_batch":
+                    case "chat_history":
+                        // A flush interval's messages, or the backlog replayed on joining a channel; oldest first
+                        var channel = json["channel"]?.ToString();
+                        var batch = json["messages"]?.ToObject<ChatMessageEventArgs[]>();
+                        foreach (var entry in batch ?? Array.Empty<ChatMessageEventArgs>())
+                        {
+                            entry.Channel ??= channel;
+                            if (IsNewChatMessage(entry, type == "chat_batch"))
+                            {
+                                OnChatMessage?.Invoke(this, entry);
+                            }
+                        }
+                        break;
+
                     case "state_update":
                         var stateUpdate = json.ToObject<StateUpdateEventArgs>();
+                        if (stateUpdate != null && stateUpdate.Tick > _lastServerTick)
+                        {
+                            _lastServerTick = stateUpdate.Tick;
+                        }
                         OnStateUpdate?.Invoke(this, stateUpdate ?? new StateUpdateEventArgs());
                         break;
 
                     case "pong":
-                        // Handle ping response
+                        if (_pingSentAt != 0)
+                        {
+                            _latency = (Stopwatch.GetTimestamp() - _pingSentAt) * 1000.0 / Stopwatch.Frequency;
+                        }
                         break;
 
                     default:
@@ -177,6 +302,57 @@ namespace GameServerSDK
             }
         }
 
+        // A live batch can arrive just before the join replay that repeats it (and a resume
+        // replays what was already raised); drop replayed messages already seen live
+        private bool IsNewChatMessage(ChatMessageEventArgs entry, bool live)
+        {
+            if (entry.Sequence == 0)
+            {
+                return true;
+            }
+            var key = entry.Channel ?? "";
+            _chatSeen.TryGetValue(key, out var seen);
+            bool duplicate = live
+                ? entry.Sequence <= seen.Through
+                : seen.LiveFrom > 0 && entry.Sequence >= seen.LiveFrom && entry.Sequence <= seen.Through;
+            if (live && seen.LiveFrom == 0)
+            {
+                seen.LiveFrom = entry.Sequence;
+            }
+            seen.Through = Math.Max(seen.Through, entry.Sequence);
+            _chatSeen[key] = seen;
+            return !duplicate;
+        }
+
+        private async Task HandleBinaryMessageAsync(byte[] payload)
+        {
+            try
+            {
+                var stateUpdate = _stateDecoder.Decode(payload, out ulong tick);
+                if (stateUpdate == null)
+                {
+                    return;
+                }
+
+                // Acknowledge so the server diffs the next update against this tick
+                if (_webSocket != null && _webSocket.State == WebSocketState.Open)
+                {
+                    var ack = StateDeltaDecoder.EncodeAck(tick);
+                    await _webSocket.SendAsync(new ArraySegment<byte>(ack), WebSocketMessageType.Binary, true, CancellationToken.None);
+                }
+
+                if (tick > _lastServerTick)
+                {
+                    _lastServerTick = tick;
+                }
+                OnStateUpdate?.Invoke(this, stateUpdate);
+            }
+            catch (Exception ex)
+            {
+                OnError?.Invoke(this, new ErrorEventArgs { Exception = ex, Message = "Error decoding state update" });
+            }
+        }
+
         private async Task SendMessageAsync(object message)
         {
             if (!IsConnected || _webSocket == null)
@@ -186,7 +362,15 @@ namespace GameServerSDK
 
             var json = JsonConvert.SerializeObject(message);
             var bytes = Encoding.UTF8.GetBytes(json);
-            await _webSocket.SendAsync(new ArraySegment<byte>(bytes), WebSocketMessageType.Text, true, CancellationToken.None);
+            await _sendLock.WaitAsync();
+            try
+            {
+                await _webSocket.SendAsync(new ArraySegment<byte>(bytes), WebSocketMessageType.Text, true, CancellationToken.None);
+            }
+            finally
+            {
+                _sendLock.Release();
+            }
         }
 
         /// <summary>
@@ -221,21 +405,82 @@ namespace GameServerSDK
         }
 
         /// <summary>
-        /// Sends a game action to the server
+        /// Queues a game action for the current frame's batch. The returned task completes
+        /// when the batch has been sent (after about one frame, or at FlushActionsAsync).
         /// </summary>
-        public async Task SendGameActionAsync(string actionType, object actionData)
+        public Task SendGameActionAsync(string actionType, object actionData)
         {
-            var action = new
+            lock (_actionLock)
             {
-                type = "game_action",
-                actionId = ++_sequenceNumber,
-                timestamp = DateTimeOffset.UtcNow.ToUnixTimeMilliseconds(),
-                actionType = actionType,
-                data = actionData,
-                sequenceNumber = _sequenceNumber
-            };
+                _pendingActions.Add(new
+                {
+                    actionId = ++_sequenceNumber,
+                    timestamp = DateTimeOffset.UtcNow.ToUnixTimeMilliseconds(),
+                    actionType = actionType,
+                    data = actionData,
+                    sequenceNumber = _sequenceNumber,
+                    tick = _lastServerTick
+                });
+
+                if (_pendingActions.Count + RedundantActions >= MaxBatchActions)
+                {
+                    return FlushActionsAsync();
+                }
+                _flushTask ??= FlushAfterFrameAsync();
+                return _flushTask;
+            }
+        }
 
-            await SendMessageAsync(action);
+        /// <summary>
+        /// Sends the queued game actions now. Call it at the end of a frame to skip the batching delay.
+        /// </summary>
+        public async Task FlushActionsAsync()
+        {
+            object batch;
+            lock (_actionLock)
+            {
+                _flushTask = null;
+                if (_pendingActions.Count == 0)
+                {
+                    return;
+                }
+
+                var actions = new List<object>(_recentActions);
+                actions.AddRange(_pendingActions);
+                foreach (var action in _pendingActions)
+                {
+                    _recentActions.Enqueue(action);
+                    if (_recentActions.Count > RedundantActions)
+                    {
+                        _recentActions.Dequeue();
+                    }
+                }
+                _pendingActions.Clear();
+
+                batch = new
+                {
+                    type = "game_actions",
+                    tick = _lastServerTick,
+                    actions = actions
+                };
+            }
+
+            await SendMessageAsync(batch);
+        }
+
+        private void ClearActions()
+        {
+            lock (_actionLock)
+            {
+                _pendingActions.Clear();
+                _recentActions.Clear();
+            }
+        }
+
+        private async Task FlushAfterFrameAsync()
+        {
+            await Task.Delay(ActionBatchInterval).ConfigureAwait(false);
+            await FlushActionsAsync().ConfigureAwait(false);
         }
 
         /// <summary>
@@ -245,9 +490,11 @@ namespace GameServerSDK
         {
             var ping = new
             {
-                type = "ping"
+                type = "ping",
+                latency = _latency
             };
 
+            _pingSentAt = Stopwatch.GetTimestamp();
             await SendMessageAsync(ping);
         }
 
@@ -255,6 +502,7 @@ namespace GameServerSDK
         {
             DisconnectAsync().Wait(TimeSpan.FromSeconds(5));
             _cancellationTokenSource?.Dispose();
+            _sendLock.Dispose();
         }
     }
 }
@@ -0,0 +1,179 @@
+using System;
+using System.Collections.Generic;
+using Newtonsoft.Json.Linq;
+
+namespace GameServerSDK
+{
+    /// <summary>
+    /// Decodes binary state deltas sent on the "game-binary" subprotocol (see server/StateCodec.h)
+    /// </summary>
+    internal class StateDeltaDecoder
+    {
+        public const byte StateDelta = 1;
+        public const byte StateAck = 2;
+
+        // tick -> decoded state; baselines the server may send deltas against
+        private readonly Dictionary<ulong, Frame> _history = new();
+
+        private class Frame
+        {
+            public Dictionary<ulong, (long X, long Y)> Players = new();
+            public Dictionary<ulong, (ulong OwnerId, long X, long Y)> Projectiles = new(); // By entity ID
+        }
+
+        /// <summary>
+        /// Applies a delta frame to its baseline. Returns null if the frame is not a state delta
+        /// or its baseline is no longer held.
+        /// </summary>
+        public StateUpdateEventArgs? Decode(byte[] data, out ulong tick)
+        {
+            tick = 0;
+            if (data.Length == 0 || data[0] != StateDelta)
+            {
+                return null;
+            }
+
+            int offset = 1;
+            tick = ReadVarint(data, ref offset);
+            ulong serverTime = ReadVarint(data, ref offset);
+            ulong baseTick = ReadVarint(data, ref offset);
+
+            Frame? baseline;
+            if (baseTick == 0)
+            {
+                baseline = new Frame();
+            }
+            else if (!_history.TryGetValue(baseTick, out baseline))
+            {
+                return null;
+            }
+
+            var frame = new Frame
+            {
+                Players = new Dictionary<ulong, (long X, long Y)>(baseline.Players),
+                Projectiles = new Dictionary<ulong, (ulong OwnerId, long X, long Y)>(baseline.Projectiles)
+            };
+            var players = frame.Players;
+            ulong upserts = ReadVarint(data, ref offset);
+            for (ulong i = 0; i < upserts; i++)
+            {
+                ulong id = ReadVarint(data, ref offset);
+                long x = ReadZigzag(data, ref offset);
+                long y = ReadZigzag(data, ref offset);
+                players[id] = (x, y);
+            }
+
+            ulong removals = ReadVarint(data, ref offset);
+            for (ulong i = 0; i < removals; i++)
+            {
+                players.Remove(ReadVarint(data, ref offset));
+            }
+
+            var projectiles = frame.Projectiles;
+            ulong projectileUpserts = ReadVarint(data, ref offset);
+            for (ulong i = 0; i < projectileUpserts; i++)
+            {
+                ulong id = ReadVarint(data, ref offset);
+                ulong ownerId = ReadVarint(data, ref offset);
+                long x = ReadZigzag(data, ref offset);
+                long y = ReadZigzag(data, ref offset);
+                projectiles[id] = (ownerId, x, y);
+            }
+
+            ulong projectileRemovals = ReadVarint(data, ref offset);
+            for (ulong i = 0; i < projectileRemovals; i++)
+            {
+                projectiles.Remove(ReadVarint(data, ref offset));
+            }
+
+            // Later deltas are never based on anything older than this baseline
+            _history[tick] = frame;
+            var stale = new List<ulong>();
+            foreach (var key in _history.Keys)
+            {
+                if (key < baseTick)
+                {
+                    stale.Add(key);
+                }
+            }
+            foreach (var key in stale)
+            {
+                _history.Remove(key);
+            }
+
+            var playersJson = new JObject();
+            foreach (var pair in players)
+            {
+                playersJson.Add(pair.Key.ToString(), new JObject(new JProperty("x", pair.Value.X), new JProperty("y", pair.Value.Y)));
+            }
+
+            // Same shape as the JSON state's "entities"
+            var entitiesJson = new JArray();
+            foreach (var pair in projectiles)
+            {
+                entitiesJson.Add(new JObject(
+                    new JProperty("id", pair.Key),
+                    new JProperty("type", "projectile"),
+                    new JProperty("ownerId", pair.Value.OwnerId),
+                    new JProperty("x", pair.Value.X),
+                    new JProperty("y", pair.Value.Y)));
+            }
+
+            return new StateUpdateEventArgs
+            {
+                ServerTime = serverTime,
+                Tick = tick,
+                State = new JObject(new JProperty("players", playersJson), new JProperty("entities", entitiesJson))
+            };
+        }
+
+        /// <summary>
+        /// Builds the ack frame telling the server which tick to use as the next baseline
+        /// </summary>
+        public static byte[] EncodeAck(ulong tick)
+        {
+            var bytes = new List<byte> { StateAck };
+            while (tick >= 0x80)
+            {
+                bytes.Add((byte)((tick & 0x7F) | 0x80));
+                tick >>= 7;
+            }
+            bytes.Add((byte)tick);
+            return bytes.ToArray();
+        }
+
+        /// <summary>
+        /// Whether tick is still held as a baseline
+        /// </summary>
+        public bool HasBaseline(ulong tick)
+        {
+            return _history.ContainsKey(tick);
+        }
+
+        public void Reset()
+        {
+            _history.Clear();
+        }
+
+        private static ulong ReadVarint(byte[] data, ref int offset)
+        {
+            ulong value = 0;
+            for (int shift = 0; shift < 64 && offset < data.Length; shift += 7)
+            {
+                byte b = data[offset++];
+                value |= (ulong)(b & 0x7F) << shift;
+                if ((b & 0x80) == 0)
+                {
+                    break;
+                }
+            }
+            return value;
+        }
+
+        private static long ReadZigzag(byte[] data, ref int offset)
+        {
+            ulong v = ReadVarint(data, ref offset);
+            return (long)(v >> 1) ^ -(long)(v & 1);
+        }
+    }
+}
@@ -0,0 +1,228 @@
+#include "ActionLog.h"
+#include "Log.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ActionLog {
+
+Writer::Writer(const std::string& path, const FileHeader& header)
+    : m_path(path), m_header(header), m_ring(RING_CAPACITY), m_lost(false), m_finished(false),
+      m_fd(-1), m_mapping(nullptr), m_mappedBytes(0), m_used(0) {
+}
+
+Writer::~Writer() {
+    close();
+}
+
+bool Writer::open() {
+    m_fd = ::open(m_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m_fd < 0) {
+        LOG_ERROR("ActionLog", "Cannot create {}: {}", m_path, std::strerror(errno));
+        return false;
+    }
+    if (!reserve(sizeof(FileHeader))) {
+        close();
+        return false;
+    }
+    std::memcpy(m_mapping, &m_header, sizeof(FileHeader));
+    m_used = sizeof(FileHeader);
+    return true;
+}
+
+bool Writer::append(const Record& record) {
+    if (m_lost.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    Record copy = record;
+    if (!m_ring.tryPush(std::move(copy))) {
+        // Anything after a gap would replay against the wrong state, so stop here
+        m_lost.store(true, std::memory_order_relaxed);
+        LOG_WARN("ActionLog", "Recording {} fell behind; truncated at tick {}", m_path, record.tick);
+        return false;
+    }
+    return true;
+}
+
+void Writer::finish() {
+    m_finished.store(true, std::memory_order_release);
+}
+
+void Writer::flush() {
+    Record record;
+    while (m_fd >= 0 && m_ring.tryPop(record)) {
+        if (!reserve(sizeof(Record))) {
+            m_lost.store(true, std::memory_order_relaxed);
+            return;
+        }
+        std::memcpy(m_mapping + m_used, &record, sizeof(Record));
+        m_used += sizeof(Record);
+    }
+}
+
+void Writer::close() {
+    if (m_fd < 0) {
+        return;
+    }
+    if (m_mapping) {
+        if (m_lost.load(std::memory_order_relaxed)) {
+            reinterpret_cast<FileHeader*>(m_mapping)->flags |= FLAG_TRUNCATED;
+        }
+        munmap(m_mapping, m_mappedBytes);
+        m_mapping = nullptr;
+    }
+    // Drop the unused tail of the last growth step
+    if (ftruncate(m_fd, static_cast<off_t>(m_used)) != 0) {
+        LOG_WARN("ActionLog", "Cannot trim {}: {}", m_path, std::strerror(errno));
+    }
+    ::close(m_fd);
+    m_fd = -1;
+}
+
+bool Writer::reserve(size_t bytes) {
+    if (m_used + bytes <= m_mappedBytes) {
+        return true;
+    }
+
+    // Grow the file and remap; the old mapping's pages are already in the file
+    size_t size = std::max(m_mappedBytes + GROW_BYTES, m_used + bytes);
+    if (m_mapping) {
+        munmap(m_mapping, m_mappedBytes);
+        m_mapping = nullptr;
+        m_mappedBytes = 0;
+    }
+    if (ftruncate(m_fd, static_cast<off_t>(size)) != 0) {
+        LOG_ERROR("ActionLog", "Cannot grow {}: {}", m_path, std::strerror(errno));
+        return false;
+    }
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (mapping == MAP_FAILED) {
+        LOG_ERROR("ActionLog", "Cannot map {}: {}", m_path, std::strerror(errno));
+        return false;
+    }
+    m_mapping = static_cast<char*>(mapping);
+    m_mappedBytes = size;
+    return true;
+}
+
+Recorder::~Recorder() {
+    stop();
+}
+
+std::shared_ptr<Writer> Recorder::open(const std::string& path, const FileHeader& header) {
+    std::shared_ptr<Writer> writer(new Writer(path, header));
+    if (!writer->open()) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_writers.push_back(writer);
+    return writer;
+}
+
+void Recorder::start(std::chrono::milliseconds interval) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_running) {
+        return;
+    }
+    m_interval = interval;
+    m_running = true;
+    m_thread = std::thread(&Recorder::run, this);
+}
+
+void Recorder::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) {
+            return;
+        }
+        m_running = false;
+    }
+    m_wake.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    flushAll(true);
+}
+
+void Recorder::run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_running) {
+        lock.unlock();
+        flushAll(false);
+        lock.lock();
+        m_wake.wait_for(lock, m_interval, [this] { return !m_running; });
+    }
+}
+
+void Recorder::flushAll(bool closeAll) {
+    std::vector<std::shared_ptr<Writer>> writers;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        writers = m_writers;
+    }
+
+    for (const auto& writer : writers) {
+        // Read before draining so nothing appended before finish() is left behind
+        bool finished = writer->m_finished.load(std::memory_order_acquire);
+        writer->flush();
+        if (finished || closeAll) {
+            writer->close();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_writers.erase(std::remove(m_writers.begin(), m_writers.end(), writer), m_writers.end());
+        }
+    }
+}
+
+Reader::~Reader() {
+    if (m_mapping) {
+        munmap(m_mapping, m_mappedBytes);
+    }
+}
+
+bool Reader::open(const std::string& path, std::string& error) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = path + ": " + std::strerror(errno);
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(FileHeader)) {
+        error = path + ": not an action log";
+        ::close(fd);
+        return false;
+    }
+
+    m_mappedBytes = static_cast<size_t>(info.st_size);
+    void* mapping = mmap(nullptr, m_mappedBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        error = path + ": " + std::strerror(errno);
+        m_mappedBytes = 0;
+        return false;
+    }
+    m_mapping = mapping;
+
+    m_header = static_cast<const FileHeader*>(mapping);
+    if (std::memcmp(m_header->magic, MAGIC, sizeof(MAGIC)) != 0) {
+        error = path + ": not an action log";
+        return false;
+    }
+    if (m_header->version != VERSION) {
+        error = path + ": unsupported version " + std::to_string(m_header->version);
+        return false;
+    }
+
+    m_records = reinterpret_cast<const Record*>(static_cast<const char*>(mapping) + sizeof(FileHeader));
+    size_t available = (m_mappedBytes - sizeof(FileHeader)) / sizeof(Record);
+    m_recordCount = 0;
+    while (m_recordCount < available && m_records[m_recordCount].kind != RecordKind::End) {
+        ++m_recordCount;
+    }
+    return true;
+}
+
+} // namespace ActionLog
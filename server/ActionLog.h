@@ -0,0 +1,158 @@
+#pragma once
+
+#include "MpscRing.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Deterministic recording of one world's simulation inputs, replayed offline by
+// GameServerReplay. A recording is the world's RNG seed plus every action the tick
+// thread accepted, in the order it took them off the queue, and one Tick record per
+// tick carrying a hash of the entity state at the end of that tick.
+//
+// File layout: a FileHeader followed by fixed-size Records. A tick's Action records
+// precede its Tick record. The file is append-only and memory-mapped; a recording
+// cut short by a crash ends at the first all-zero record.
+//
+// The tick thread only copies records into a lock-free ring (Writer::append); the
+// Recorder thread moves them into the mapping. If the ring overflows the recording
+// stops there and is marked truncated rather than ever blocking a tick.
+namespace ActionLog {
+
+constexpr char MAGIC[8] = {'G', 'S', 'A', 'C', 'T', 'L', 'O', 'G'};
+constexpr uint32_t VERSION = 1;
+constexpr uint32_t FLAG_TRUNCATED = 1; // Records were lost; replay ends at the gap
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t seed; // World RNG seed
+    int32_t tickRate;
+    int32_t worldSize;
+    char roomId[40]; // NUL padded, truncated if longer
+};
+
+enum class RecordKind : uint8_t {
+    End = 0, // Unwritten space after a crash
+    Action = 1,
+    Tick = 2
+};
+
+struct Record {
+    RecordKind kind;
+    uint8_t actionType; // MessageParser::ActionType
+    uint8_t late;       // Rewound: inserted at targetTick and re-simulated forward
+    uint8_t reserved[5];
+    uint64_t tick;      // Tick the record belongs to
+
+    // Action
+    uint64_t playerId;
+    uint64_t actionId;
+    uint64_t timestamp;
+    uint64_t clientSequenceNumber;
+    uint64_t targetTick; // Late actions: tick after lag-compensation clamping
+    int32_t dx;
+    int32_t dy;
+
+    // Tick
+    uint64_t serverTime;
+    uint64_t stateHash; // EntityStore::stateHash() at the end of the tick
+    uint64_t rngDraws;  // World RNG values drawn so far; with the seed, the RNG state
+};
+
+static_assert(sizeof(FileHeader) % 8 == 0, "records must stay 8-byte aligned in the mapping");
+
+// One world's recording. Append from the tick thread; flushed by a Recorder.
+class Writer {
+public:
+    ~Writer();
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    bool append(const Record& record); // False once the recording has lost a record
+    void finish();                     // The world is gone; the Recorder closes the file once drained
+
+    const std::string& getPath() const { return m_path; }
+
+private:
+    friend class Recorder;
+
+    static constexpr size_t RING_CAPACITY = 4096;
+    static constexpr size_t GROW_BYTES = 4 << 20;
+
+    Writer(const std::string& path, const FileHeader& header);
+    bool open();
+    void flush(); // Recorder thread
+    void close();
+    bool reserve(size_t bytes);
+
+    std::string m_path;
+    FileHeader m_header;
+    MpscRing<Record> m_ring;
+    std::atomic<bool> m_lost;
+    std::atomic<bool> m_finished;
+
+    // Recorder thread only
+    int m_fd;
+    char* m_mapping;
+    size_t m_mappedBytes;
+    size_t m_used;
+};
+
+// Background thread that flushes every open Writer
+class Recorder {
+public:
+    Recorder() = default;
+    ~Recorder();
+
+    // Creates path (truncating it) and writes the header; nullptr if it cannot be opened
+    std::shared_ptr<Writer> open(const std::string& path, const FileHeader& header);
+
+    void start(std::chrono::milliseconds interval);
+    void stop(); // Flushes and closes everything
+
+private:
+    std::vector<std::shared_ptr<Writer>> m_writers;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::thread m_thread;
+    std::chrono::milliseconds m_interval{10};
+    bool m_running = false;
+
+    void run();
+    void flushAll(bool closeAll);
+};
+
+// Read-only view of a recording
+class Reader {
+public:
+    Reader() = default;
+    ~Reader();
+
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    bool open(const std::string& path, std::string& error);
+
+    const FileHeader& header() const { return *m_header; }
+    const Record* records() const { return m_records; }
+    size_t recordCount() const { return m_recordCount; }
+
+private:
+    void* m_mapping = nullptr;
+    size_t m_mappedBytes = 0;
+    const FileHeader* m_header = nullptr;
+    const Record* m_records = nullptr;
+    size_t m_recordCount = 0;
+};
+
+} // namespace ActionLog
@@ -6,32 +6,90 @@
 #include <vector>
 
 ChatSystem::ChatSystem(PlayerManager* playerManager, WebSocketServer* wsServer) 
-    : m_playerManager(playerManager), m_wsServer(wsServer) {
+    : m_playerManager(playerManager), m_wsServer(wsServer), m_running(false), m_rateLimited(0), m_suppressed(0) {
 }
 
 ChatSystem::~ChatSystem() {
+    stop();
 }
 
-void ChatSystem::handleMessage(uint64_t playerId, const Json::Value& messageData) {
-    std::string message = messageData.get("message", "").asString();
-    std::string channel = messageData.get("channel", "global").asString();
+void ChatSystem::start(std::chrono::milliseconds flushInterval) {
+    if (m_running) {
+        return;
+    }
+    m_running = true;
+    m_flushThread = std::thread(&ChatSystem::flushLoop, this, flushInterval);
+}
+
+void ChatSystem::stop() {
+    m_running = false;
+    if (m_flushThread.joinable()) {
+        m_flushThread.join();
+    }
+}
+
+void ChatSystem::flush() {
+    std::lock_guard<std::mutex> flushLock(m_flushMutex);
+    std::unordered_map<std::string, std::vector<ChatMessage>> pending;
+    {
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        if (m_pending.empty()) {
+            return;
+        }
+        pending.swap(m_pending);
+    }
     
-    if (validateMessage(message)) {
-        sendMessage(playerId, message, channel);
+    for (const auto& pair : pending) {
+        broadcastBatch(pair.first, pair.second);
+    }
+    
+    // Later joins replay what was just broadcast
+    std::lock_guard<std::mutex> lock(m_messagesMutex);
+    for (const auto& pair : pending) {
+        auto it = m_channels.find(pair.first);
+        if (it != m_channels.end()) {
+            it->second.flushed = std::max(it->second.flushed, pair.second.back().sequence);
+        }
+    }
+}
+
+void ChatSystem::handleMessage(uint64_t playerId, const MessageParser::ChatPayload& payload) {
+    std::string message(payload.message);
+    if (validateMessage(message) && admitMessage(playerId, message)) {
+        sendMessage(playerId, message, std::string(payload.channel));
     }
 }
 
 void ChatSystem::removePlayer(uint64_t playerId) {
-    // Player removal is handled by PlayerManager
-    // Chat messages remain in history
+    {
+        std::lock_guard<std::mutex> lock(m_sendersMutex);
+        m_senders.erase(playerId);
+    }
+    
+    // Messages remain in history; drop the player's interned name once nothing references it
+    PlayerManager::PlayerSnapshot player = m_playerManager->getPlayer(playerId);
+    if (!player) {
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(m_messagesMutex);
+    auto it = m_usernames.find(player->username);
+    if (it != m_usernames.end() && it->second.use_count() == 1) {
+        m_usernames.erase(it);
+    }
 }
 
 void ChatSystem::sendMessage(uint64_t playerId, const std::string& message, const std::string& channel) {
-    const Player* player = m_playerManager->getPlayer(playerId);
+    PlayerManager::PlayerSnapshot player = m_playerManager->getPlayer(playerId);
     if (!player) {
         return;
     }
     
+    // Room channels are match IDs; only that match's players may post there
+    if (channel != "global" && (!player->inMatch || player->currentMatchId != channel)) {
+        return;
+    }
+    
     ChatMessage chatMsg;
     chatMsg.playerId = playerId;
     chatMsg.username = player->username;
@@ -40,48 +98,135 @@ void ChatSystem::sendMessage(uint64_t playerId, const std::string& message, cons
         std::chrono::steady_clock::now().time_since_epoch()).count();
     chatMsg.channel = channel;
     
+    std::lock_guard<std::mutex> lock(m_messagesMutex);
+    ChannelHistory& history = m_channels[channel];
+    if (history.slots.size() < MAX_MESSAGES_PER_CHANNEL) {
+        history.slots.emplace_back();
+    }
+    StoredMessage& slot = history.slots[history.appended % MAX_MESSAGES_PER_CHANNEL];
+    slot.playerId = playerId;
+    slot.username = internUsername(chatMsg.username);
+    slot.message.assign(message);
+    slot.timestamp = chatMsg.timestamp;
+    chatMsg.sequence = ++history.appended;
+    
+    // Queued under the history lock so batches stay in sequence order
+    std::lock_guard<std::mutex> pendingLock(m_pendingMutex);
+    m_pending[channel].push_back(std::move(chatMsg));
+}
+
+std::vector<ChatMessage> ChatSystem::getRecentMessages(const std::string& channel, int count) const {
+    std::lock_guard<std::mutex> lock(m_messagesMutex);
+    auto it = m_channels.find(channel);
+    if (it == m_channels.end()) {
+        return {};
+    }
+    return recentLocked(channel, it->second, it->second.appended, count);
+}
+
+void ChatSystem::joinChannel(uint64_t playerId, const std::string& channel) {
+    if (!m_wsServer) {
+        return;
+    }
+    
+    // Messages still pending reach the player in the next batch; the player is
+    // already in the channel's room
+    std::lock_guard<std::mutex> flushLock(m_flushMutex);
+    std::vector<ChatMessage> backlog;
     {
         std::lock_guard<std::mutex> lock(m_messagesMutex);
-        if (channel == "global") {
-            m_globalMessages.push_back(chatMsg);
-            
-            // Keep only recent messages
-            if (m_globalMessages.size() > MAX_MESSAGES_PER_CHANNEL) {
-                m_globalMessages.erase(m_globalMessages.begin());
-            }
+        auto it = m_channels.find(channel);
+        if (it != m_channels.end()) {
+            backlog = recentLocked(channel, it->second, it->second.flushed, REPLAY_MESSAGES);
         }
     }
+    if (backlog.empty()) {
+        return;
+    }
     
-    broadcastMessage(chatMsg);
+    Json::Value response;
+    response["type"] = "chat_history";
+    response["channel"] = channel;
+    Json::Value messages(Json::arrayValue);
+    for (const ChatMessage& chatMsg : backlog) {
+        Json::Value entry;
+        entry["playerId"] = static_cast<Json::UInt64>(chatMsg.playerId);
+        entry["username"] = chatMsg.username;
+        entry["message"] = chatMsg.message;
+        entry["timestamp"] = static_cast<Json::UInt64>(chatMsg.timestamp);
+        entry["channel"] = chatMsg.channel;
+        entry["seq"] = static_cast<Json::UInt64>(chatMsg.sequence);
+        messages.append(entry);
+    }
+    response["messages"] = messages;
+    
+    m_wsServer->send(playerId, response.toStyledString());
 }
 
-std::vector<ChatMessage> ChatSystem::getRecentMessages(const std::string& channel, int count) const {
-    std::lock_guard<std::mutex> lock(const_cast<std::mutex&>(m_messagesMutex));
-    
-    std::vector<ChatMessage> result;
+void ChatSystem::removeChannel(const std::string& channel) {
     if (channel == "global") {
-        int start = std::max(0, static_cast<int>(m_globalMessages.size()) - count);
-        result.assign(m_globalMessages.begin() + start, m_globalMessages.end());
+        return;
     }
+    std::lock_guard<std::mutex> lock(m_messagesMutex);
+    m_channels.erase(channel);
+}
+
+ChatSystem::InternedString ChatSystem::internUsername(const std::string& username) {
+    auto it = m_usernames.find(username);
+    if (it != m_usernames.end()) {
+        return it->second;
+    }
+    InternedString interned = std::make_shared<const std::string>(username);
+    m_usernames.emplace(username, interned);
+    return interned;
+}
+
+std::vector<ChatMessage> ChatSystem::recentLocked(const std::string& channel, const ChannelHistory& history, uint64_t end,
+                                                  int count) const {
+    // The ring holds the last slots.size() appended; only those before end count
+    uint64_t oldest = history.appended - std::min<uint64_t>(history.appended, history.slots.size());
+    uint64_t available = end > oldest ? end - oldest : 0;
+    uint64_t n = std::min<uint64_t>(available, static_cast<uint64_t>(std::max(0, count)));
     
+    // Oldest first
+    std::vector<ChatMessage> result;
+    result.reserve(n);
+    for (uint64_t seq = end - n; seq < end; ++seq) {
+        const StoredMessage& slot = history.slots[seq % MAX_MESSAGES_PER_CHANNEL];
+        ChatMessage chatMsg;
+        chatMsg.playerId = slot.playerId;
+        chatMsg.username = *slot.username;
+        chatMsg.message = slot.message;
+        chatMsg.timestamp = slot.timestamp;
+        chatMsg.channel = channel;
+        chatMsg.sequence = seq + 1;
+        result.push_back(std::move(chatMsg));
+    }
     return result;
 }
 
-void ChatSystem::broadcastMessage(const ChatMessage& chatMsg) {
-    // Create JSON response
+void ChatSystem::broadcastBatch(const std::string& channel, const std::vector<ChatMessage>& batch) {
+    // One frame per channel per flush, however many messages it carries
     Json::Value response;
-    response["type"] = "chat_message";
-    response["playerId"] = static_cast<Json::UInt64>(chatMsg.playerId);
-    response["username"] = chatMsg.username;
-    response["message"] = chatMsg.message;
-    response["timestamp"] = static_cast<Json::UInt64>(chatMsg.timestamp);
-    response["channel"] = chatMsg.channel;
+    response["type"] = "chat_batch";
+    response["channel"] = channel;
+    Json::Value messages(Json::arrayValue);
+    for (const ChatMessage& chatMsg : batch) {
+        Json::Value entry;
+        entry["playerId"] = static_cast<Json::UInt64>(chatMsg.playerId);
+        entry["username"] = chatMsg.username;
+        entry["message"] = chatMsg.message;
+        entry["timestamp"] = static_cast<Json::UInt64>(chatMsg.timestamp);
+        entry["seq"] = static_cast<Json::UInt64>(chatMsg.sequence);
+        messages.append(entry);
+    }
+    response["messages"] = messages;
     
     if (m_wsServer) {
-        if (chatMsg.channel == "global") {
+        if (channel == "global") {
             m_wsServer->broadcast(response.toStyledString());
         } else {
-            m_wsServer->broadcastToRoom(chatMsg.channel, response.toStyledString());
+            m_wsServer->broadcastToRoom(channel, response.toStyledString());
         }
     }
 }
@@ -98,3 +243,44 @@ bool ChatSystem::validateMessage(const std::string& message) const {
     return true;
 }
 
+bool ChatSystem::admitMessage(uint64_t playerId, const std::string& message) {
+    uint64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    size_t hash = std::hash<std::string>()(message);
+    
+    std::lock_guard<std::mutex> lock(m_sendersMutex);
+    auto inserted = m_senders.try_emplace(playerId, SenderState{RATE_LIMIT_BURST, now, 0, 0});
+    SenderState& sender = inserted.first->second;
+    
+    // Token bucket: RATE_LIMIT_PER_SECOND sustained, bursts of RATE_LIMIT_BURST
+    sender.tokens = std::min(RATE_LIMIT_BURST, sender.tokens + (now - sender.refilledAt) * RATE_LIMIT_PER_SECOND / 1000.0);
+    sender.refilledAt = now;
+    if (sender.tokens < 1.0) {
+        m_rateLimited.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    sender.tokens -= 1.0; // Suppressed repeats still cost a token
+    
+    if (hash == sender.lastMessageHash && now - sender.lastMessageAt < DUPLICATE_WINDOW_MS) {
+        m_suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    sender.lastMessageHash = hash;
+    sender.lastMessageAt = now;
+    return true;
+}
+
+void ChatSystem::flushLoop(std::chrono::milliseconds interval) {
+    auto deadline = std::chrono::steady_clock::now();
+    while (m_running) {
+        flush();
+        
+        // Absolute deadlines; a late flush isn't repeated
+        deadline += interval;
+        auto now = std::chrono::steady_clock::now();
+        if (deadline < now) {
+            deadline = now;
+        }
+        std::this_thread::sleep_until(deadline);
+    }
+}
@@ -1,10 +1,16 @@
 #pragma once
 
 #include "PlayerManager.h"
+#include "MessageParser.h"
 #include <json/json.h>
 #include <string>
 #include <vector>
+#include <memory>
+#include <unordered_map>
 #include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 
 class WebSocketServer;
@@ -15,28 +21,102 @@ struct ChatMessage {
     std::string message;
     uint64_t timestamp;
     std::string channel; // "global", "match", etc.
+    uint64_t sequence = 0; // Position in the channel's history, from 1; sent as "seq"
 };
 
+// Chat history is kept per channel in fixed-capacity rings: appending overwrites
+// the oldest slot (reusing its string storage) and reading the last k messages
+// touches only those k. Messages don't repeat their channel name, and usernames
+// are interned and shared by every stored message. "global" reaches everyone; any
+// other channel is a match ID and only reaches (and accepts messages from) that
+// match's players.
+//
+// Fan-out is batched: messages are queued per channel and a flush thread sends
+// each channel's queue as one "chat_batch" frame every flush interval. Player
+// messages are rate limited (token bucket) and repeated ones suppressed on
+// ingress, before they are stored or queued.
+//
+// A join replays history only up to the last flushed message, so nothing is both
+// replayed and delivered in a later batch. Entries carry their channel sequence
+// number so clients can drop a batch that reached them just before the replay.
 class ChatSystem {
 public:
     ChatSystem(PlayerManager* playerManager, WebSocketServer* wsServer);
     ~ChatSystem();
     
-    void handleMessage(uint64_t playerId, const Json::Value& messageData); // JSON variant
+    void start(std::chrono::milliseconds flushInterval); // Flushes batches every interval on its own thread
+    void stop();
+    void flush(); // Sends every pending batch now
+    
+    void handleMessage(uint64_t playerId, const MessageParser::ChatPayload& payload); // Rate limited
     void removePlayer(uint64_t playerId);
     
+    // Sends the player the channel's recent history as one "chat_history" message
+    void joinChannel(uint64_t playerId, const std::string& channel);
+    void removeChannel(const std::string& channel); // Drops a finished match's history
+    
     void sendMessage(uint64_t playerId, const std::string& message, const std::string& channel = "global");
     std::vector<ChatMessage> getRecentMessages(const std::string& channel = "global", int count = 50) const;
     
+    uint64_t getRateLimitedCount() const { return m_rateLimited.load(std::memory_order_relaxed); }
+    uint64_t getSuppressedCount() const { return m_suppressed.load(std::memory_order_relaxed); }
+
 private:
+    using InternedString = std::shared_ptr<const std::string>;
+    
+    struct StoredMessage {
+        uint64_t playerId;
+        InternedString username;
+        std::string message; // Keeps its capacity when the slot is reused
+        uint64_t timestamp;
+    };
+    
+    // Grows to MAX_MESSAGES_PER_CHANNEL slots, then overwrites the oldest
+    struct ChannelHistory {
+        std::vector<StoredMessage> slots;
+        uint64_t appended = 0;
+        uint64_t flushed = 0; // Messages already broadcast; replays stop here
+    };
+    
     PlayerManager* m_playerManager;
     WebSocketServer* m_wsServer;
-    std::vector<ChatMessage> m_globalMessages;
-    std::mutex m_messagesMutex;
+    std::unordered_map<std::string, ChannelHistory> m_channels;
+    std::unordered_map<std::string, InternedString> m_usernames;
+    mutable std::mutex m_messagesMutex;
     
     static const size_t MAX_MESSAGES_PER_CHANNEL = 1000;
+    static const int REPLAY_MESSAGES = 50; // Backlog sent on joining a channel
+    
+    // Messages waiting for the next flush, per channel, in sequence order (queued
+    // with m_messagesMutex held)
+    std::unordered_map<std::string, std::vector<ChatMessage>> m_pending;
+    std::mutex m_pendingMutex;
+    std::mutex m_flushMutex; // Held across a flush and a join's replay, so they never interleave
+    std::thread m_flushThread;
+    std::atomic<bool> m_running;
+    
+    // Ingress limits per player
+    struct SenderState {
+        double tokens;
+        uint64_t refilledAt;
+        size_t lastMessageHash;
+        uint64_t lastMessageAt;
+    };
+    std::unordered_map<uint64_t, SenderState> m_senders;
+    std::mutex m_sendersMutex;
+    std::atomic<uint64_t> m_rateLimited;
+    std::atomic<uint64_t> m_suppressed;
+    static constexpr double RATE_LIMIT_BURST = 5.0;
+    static constexpr double RATE_LIMIT_PER_SECOND = 1.0;
+    static const uint64_t DUPLICATE_WINDOW_MS = 10000; // Same text again within this is dropped
     
-    void broadcastMessage(const ChatMessage& chatMsg);
+    InternedString internUsername(const std::string& username); // m_messagesMutex held
+    // Up to count messages before sequence end + 1, oldest first
+    std::vector<ChatMessage> recentLocked(const std::string& channel, const ChannelHistory& history, uint64_t end,
+                                          int count) const;
+    void broadcastBatch(const std::string& channel, const std::vector<ChatMessage>& batch);
     bool validateMessage(const std::string& message) const;
+    bool admitMessage(uint64_t playerId, const std::string& message); // Rate limit and spam check
+    void flushLoop(std::chrono::milliseconds interval);
 };
 
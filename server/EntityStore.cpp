@@ -0,0 +1,241 @@
+#include "EntityStore.h"
+#include <algorithm>
+
+namespace {
+
+// Clones block if a snapshot still shares it. Only the owning thread adds
+// references, so a count of 1 cannot grow under us.
+template <typename Block>
+Block& unshare(std::shared_ptr<Block>& block) {
+    if (block.use_count() != 1) {
+        block = std::make_shared<Block>(*block);
+    }
+    return *block;
+}
+
+} // namespace
+
+EntityStore::PlayerChunk::PlayerChunk() {
+    std::fill(std::begin(handles), std::end(handles), INVALID_HANDLE);
+}
+
+EntityStore::Handle EntityStore::create(EntityType type, uint64_t ownerId, int32_t x, int32_t y, int32_t vx, int32_t vy) {
+    // Most recently freed first, so handle assignment is deterministic for replays
+    Handle handle;
+    if (m_freeHead != NO_FREE_HANDLE) {
+        handle = m_freeHead;
+        m_freeHead = sparse(handle) & ~FREE_FLAG;
+    } else {
+        handle = m_handleCount++;
+        if (handle / CHUNK_SIZE == m_sparse.size()) {
+            m_sparse.push_back(std::make_shared<SparseChunk>());
+        }
+    }
+
+    size_t i = m_size++;
+    if (i / CHUNK_SIZE == m_chunks.size()) {
+        m_chunks.push_back(std::make_shared<Chunk>());
+    }
+
+    Chunk& c = mutableChunk(i);
+    size_t slot = i % CHUNK_SIZE;
+    c.handles[slot] = handle;
+    c.types[slot] = type;
+    c.owners[slot] = ownerId;
+    c.x[slot] = x;
+    c.y[slot] = y;
+    c.vx[slot] = vx;
+    c.vy[slot] = vy;
+    c.age[slot] = 0;
+
+    mutableSparse(handle) = static_cast<uint32_t>(i);
+    if (type == EntityType::Player) {
+        insertPlayer(ownerId, handle);
+    }
+    return handle;
+}
+
+void EntityStore::destroy(Handle handle) {
+    if (!isValid(handle)) {
+        return;
+    }
+
+    size_t i = sparse(handle);
+    size_t last = m_size - 1;
+
+    if (type(i) == EntityType::Player) {
+        erasePlayer(owner(i));
+    }
+
+    // Swap-remove keeps every component array packed
+    if (i != last) {
+        copyEntity(last, i);
+        mutableSparse(this->handle(i)) = static_cast<uint32_t>(i);
+    }
+
+    m_size--;
+    if (m_size % CHUNK_SIZE == 0) {
+        m_chunks.pop_back();
+    }
+
+    mutableSparse(handle) = FREE_FLAG | m_freeHead;
+    m_freeHead = handle;
+}
+
+bool EntityStore::isValid(Handle handle) const {
+    return handle < m_handleCount && (sparse(handle) & FREE_FLAG) == 0;
+}
+
+void EntityStore::clear() {
+    *this = EntityStore();
+}
+
+EntityStore::Handle EntityStore::findPlayer(uint64_t playerId) const {
+    if (m_players.empty()) {
+        return INVALID_HANDLE;
+    }
+    size_t slot = findPlayerSlot(playerId);
+    return m_players[slot / CHUNK_SIZE]->handles[slot % CHUNK_SIZE]; // INVALID_HANDLE if empty
+}
+
+void EntityStore::setPosition(size_t i, int32_t x, int32_t y) {
+    if (this->x(i) == x && this->y(i) == y) {
+        return; // Don't unshare a block for a no-op write
+    }
+    Chunk& c = mutableChunk(i);
+    c.x[i % CHUNK_SIZE] = x;
+    c.y[i % CHUNK_SIZE] = y;
+}
+
+void EntityStore::setAge(size_t i, uint32_t age) {
+    mutableChunk(i).age[i % CHUNK_SIZE] = age;
+}
+
+uint64_t EntityStore::stateHash() const {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    auto mix = [&hash](uint64_t value) {
+        for (int byte = 0; byte < 8; ++byte) {
+            hash ^= (value >> (byte * 8)) & 0xff;
+            hash *= 0x100000001b3ull;
+        }
+    };
+
+    mix(m_size);
+    for (size_t i = 0; i < m_size; ++i) {
+        mix(handle(i));
+        mix(static_cast<uint64_t>(type(i)));
+        mix(owner(i));
+        mix(static_cast<uint32_t>(x(i)) | (static_cast<uint64_t>(static_cast<uint32_t>(y(i))) << 32));
+        mix(static_cast<uint32_t>(vx(i)) | (static_cast<uint64_t>(static_cast<uint32_t>(vy(i))) << 32));
+        mix(age(i));
+    }
+    return hash;
+}
+
+EntityStore::Chunk& EntityStore::mutableChunk(size_t i) {
+    return unshare(m_chunks[i / CHUNK_SIZE]);
+}
+
+uint32_t& EntityStore::mutableSparse(Handle handle) {
+    return unshare(m_sparse[handle / CHUNK_SIZE]).dense[handle % CHUNK_SIZE];
+}
+
+EntityStore::PlayerChunk& EntityStore::mutablePlayers(size_t slot) {
+    return unshare(m_players[slot / CHUNK_SIZE]);
+}
+
+size_t EntityStore::playerHome(uint64_t playerId) const {
+    // Player IDs differ mostly in their low bits; spread them over the table
+    uint64_t mixed = (playerId ^ (playerId >> 32)) * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>(mixed >> 32) & (m_players.size() * CHUNK_SIZE - 1);
+}
+
+size_t EntityStore::findPlayerSlot(uint64_t playerId) const {
+    size_t mask = m_players.size() * CHUNK_SIZE - 1;
+    for (size_t slot = playerHome(playerId);; slot = (slot + 1) & mask) {
+        const PlayerChunk& c = *m_players[slot / CHUNK_SIZE];
+        if (c.handles[slot % CHUNK_SIZE] == INVALID_HANDLE || c.playerIds[slot % CHUNK_SIZE] == playerId) {
+            return slot;
+        }
+    }
+}
+
+void EntityStore::insertPlayer(uint64_t playerId, Handle handle) {
+    if ((m_playerCount + 1) * 2 > m_players.size() * CHUNK_SIZE) {
+        // Rehash into fresh blocks; amortized over the inserts that filled the table
+        std::vector<std::shared_ptr<PlayerChunk>> old;
+        old.swap(m_players);
+        m_players.resize(std::max<size_t>(1, old.size() * 2));
+        for (auto& c : m_players) {
+            c = std::make_shared<PlayerChunk>();
+        }
+        m_playerCount = 0;
+        for (const auto& c : old) {
+            for (size_t s = 0; s < CHUNK_SIZE; ++s) {
+                if (c->handles[s] != INVALID_HANDLE) {
+                    insertPlayer(c->playerIds[s], c->handles[s]);
+                }
+            }
+        }
+    }
+
+    size_t slot = findPlayerSlot(playerId);
+    PlayerChunk& c = mutablePlayers(slot);
+    if (c.handles[slot % CHUNK_SIZE] == INVALID_HANDLE) {
+        m_playerCount++;
+    }
+    c.playerIds[slot % CHUNK_SIZE] = playerId;
+    c.handles[slot % CHUNK_SIZE] = handle;
+}
+
+void EntityStore::erasePlayer(uint64_t playerId) {
+    if (m_players.empty()) {
+        return;
+    }
+    size_t hole = findPlayerSlot(playerId);
+    if (m_players[hole / CHUNK_SIZE]->handles[hole % CHUNK_SIZE] == INVALID_HANDLE) {
+        return;
+    }
+
+    // Backward-shift deletion: pull later entries of the probe run into the hole
+    // unless that would put them before their home slot. No tombstones to sweep.
+    size_t mask = m_players.size() * CHUNK_SIZE - 1;
+    for (size_t slot = (hole + 1) & mask;; slot = (slot + 1) & mask) {
+        const PlayerChunk& c = *m_players[slot / CHUNK_SIZE];
+        Handle handle = c.handles[slot % CHUNK_SIZE];
+        if (handle == INVALID_HANDLE) {
+            break;
+        }
+        uint64_t id = c.playerIds[slot % CHUNK_SIZE];
+        size_t home = playerHome(id);
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            PlayerChunk& dst = mutablePlayers(hole);
+            dst.playerIds[hole % CHUNK_SIZE] = id;
+            dst.handles[hole % CHUNK_SIZE] = handle;
+            hole = slot;
+        }
+    }
+    mutablePlayers(hole).handles[hole % CHUNK_SIZE] = INVALID_HANDLE;
+    m_playerCount--;
+}
+
+void EntityStore::copyEntity(size_t from, size_t to) {
+    const Chunk& src = chunk(from);
+    size_t s = from % CHUNK_SIZE;
+    Handle h = src.handles[s];
+    EntityType t = src.types[s];
+    uint64_t o = src.owners[s];
+    int32_t px = src.x[s], py = src.y[s], pvx = src.vx[s], pvy = src.vy[s];
+    uint32_t a = src.age[s];
+
+    Chunk& dst = mutableChunk(to);
+    size_t d = to % CHUNK_SIZE;
+    dst.handles[d] = h;
+    dst.types[d] = t;
+    dst.owners[d] = o;
+    dst.x[d] = px;
+    dst.y[d] = py;
+    dst.vx[d] = pvx;
+    dst.vy[d] = pvy;
+    dst.age[d] = a;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+enum class EntityType : uint8_t {
+    Player = 0,
+    Projectile = 1
+};
+
+// Structure-of-arrays entity/component store holding the authoritative game state.
+// Entities are addressed by integer handles that map to a dense index; component
+// arrays stay packed (swap-remove on destroy) so systems iterate them linearly.
+//
+// Components live in fixed-size chunks held by shared_ptr, and so do the handle
+// index and the player lookup table. Copying a store only copies chunk pointers;
+// the first write to a shared chunk clones just that block, so a create or destroy
+// costs a few blocks however many entities the store holds. Per-tick snapshots
+// therefore share everything that did not change since the previous tick.
+class EntityStore {
+public:
+    using Handle = uint32_t;
+    static constexpr Handle INVALID_HANDLE = UINT32_MAX;
+    static constexpr size_t CHUNK_SIZE = 64; // Entities per copy-on-write block
+
+    Handle create(EntityType type, uint64_t ownerId, int32_t x, int32_t y, int32_t vx = 0, int32_t vy = 0);
+    void destroy(Handle handle);
+    bool isValid(Handle handle) const;
+    void clear();
+
+    Handle findPlayer(uint64_t playerId) const; // Player entity owned by playerId, or INVALID_HANDLE
+
+    size_t size() const { return m_size; }
+    size_t indexOf(Handle handle) const { return m_sparse[handle / CHUNK_SIZE]->dense[handle % CHUNK_SIZE]; }
+
+    // Packed components by dense index [0, size())
+    Handle handle(size_t i) const { return chunk(i).handles[i % CHUNK_SIZE]; }
+    EntityType type(size_t i) const { return chunk(i).types[i % CHUNK_SIZE]; }
+    uint64_t owner(size_t i) const { return chunk(i).owners[i % CHUNK_SIZE]; }
+    int32_t x(size_t i) const { return chunk(i).x[i % CHUNK_SIZE]; }
+    int32_t y(size_t i) const { return chunk(i).y[i % CHUNK_SIZE]; }
+    int32_t vx(size_t i) const { return chunk(i).vx[i % CHUNK_SIZE]; }
+    int32_t vy(size_t i) const { return chunk(i).vy[i % CHUNK_SIZE]; }
+    uint32_t age(size_t i) const { return chunk(i).age[i % CHUNK_SIZE]; }
+
+    void setPosition(size_t i, int32_t x, int32_t y);
+    void setAge(size_t i, uint32_t age);
+
+    // FNV-1a over every entity's components in dense order. Equal stores that reached
+    // the same state through the same operations hash equal; used to verify replays.
+    uint64_t stateHash() const;
+
+private:
+    struct Chunk {
+        Handle handles[CHUNK_SIZE];
+        EntityType types[CHUNK_SIZE];
+        uint64_t owners[CHUNK_SIZE];
+        int32_t x[CHUNK_SIZE];
+        int32_t y[CHUNK_SIZE];
+        int32_t vx[CHUNK_SIZE];
+        int32_t vy[CHUNK_SIZE];
+        uint32_t age[CHUNK_SIZE]; // Ticks since spawn
+    };
+
+    // Handle -> dense index. A recycled handle's entry holds FREE_FLAG | the next
+    // recycled handle, so the free list lives in the same blocks.
+    struct SparseChunk {
+        uint32_t dense[CHUNK_SIZE];
+    };
+
+    // Player ID -> handle, open addressing with linear probing; empty slots hold
+    // INVALID_HANDLE. Kept at most half full.
+    struct PlayerChunk {
+        uint64_t playerIds[CHUNK_SIZE];
+        Handle handles[CHUNK_SIZE];
+
+        PlayerChunk();
+    };
+
+    static constexpr uint32_t FREE_FLAG = 0x80000000u;
+    static constexpr Handle NO_FREE_HANDLE = FREE_FLAG - 1;
+
+    std::vector<std::shared_ptr<Chunk>> m_chunks;
+    std::vector<std::shared_ptr<SparseChunk>> m_sparse;
+    std::vector<std::shared_ptr<PlayerChunk>> m_players; // Power-of-two slot count
+    size_t m_size = 0;
+    uint32_t m_handleCount = 0;              // Handles ever issued
+    Handle m_freeHead = NO_FREE_HANDLE;      // Most recently recycled handle
+    size_t m_playerCount = 0;
+
+    const Chunk& chunk(size_t i) const { return *m_chunks[i / CHUNK_SIZE]; }
+    uint32_t sparse(Handle handle) const { return m_sparse[handle / CHUNK_SIZE]->dense[handle % CHUNK_SIZE]; }
+    Chunk& mutableChunk(size_t i);
+    uint32_t& mutableSparse(Handle handle);
+    PlayerChunk& mutablePlayers(size_t slot);
+    void copyEntity(size_t from, size_t to);
+
+    size_t playerHome(uint64_t playerId) const;
+    size_t findPlayerSlot(uint64_t playerId) const; // Slot holding playerId, or the empty slot ending its probe
+    void insertPlayer(uint64_t playerId, Handle handle);
+    void erasePlayer(uint64_t playerId);
+};
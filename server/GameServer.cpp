@@ -4,24 +4,66 @@
 #include "MatchmakingSystem.h"
 #include "ChatSystem.h"
 #include "PlayerManager.h"
-#include <iostream>
+#include "StateCodec.h"
+#include "WorldScheduler.h"
+#include "MessageParser.h"
+#include "ActionLog.h"
+#include "Log.h"
 #include <chrono>
 #include <json/json.h>
 #include <thread>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <openssl/crypto.h>
+#include <openssl/rand.h>
 
-GameServer::GameServer(int port) 
-    : m_running(false) {
+namespace {
+const int DEFAULT_MATCHMAKING_INTERVAL_MS = 100;
+const int CHAT_FLUSH_INTERVAL_MS = 50; // Chat fan-out is batched per channel at this cadence
+const int RECORDER_FLUSH_INTERVAL_MS = 10; // Action recordings are copied out of their rings at this cadence
+const int DEFAULT_RECONNECT_GRACE_MS = 30000;
+const size_t TOKEN_SELECTOR_CHARS = 16; // Hex; the verifier is the other 16
+const size_t REPORTED_SESSION_QUEUES = 10; // Per-connection queue series are kept to the deepest few
+}
+
+GameServer::GameServer(int port, size_t worldThreads, int serviceThreads, int tickRate, int matchmakingIntervalMs,
+                       int worldSize, int reconnectGraceMs, const std::string& recordDir) 
+    : m_tickRate(tickRate > 0 ? tickRate : GameStateManager::DEFAULT_TICK_RATE),
+      m_worldSize(worldSize > 0 ? worldSize : GameStateManager::DEFAULT_WORLD_SIZE),
+      m_recordDir(recordDir),
+      m_matchmakingInterval(matchmakingIntervalMs > 0 ? matchmakingIntervalMs : DEFAULT_MATCHMAKING_INTERVAL_MS),
+      m_reconnectGrace(reconnectGraceMs == 0 ? DEFAULT_RECONNECT_GRACE_MS : std::max(0, reconnectGraceMs)),
+      m_running(false) {
+    m_recordStamp = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    if (!m_recordDir.empty()) {
+        m_recorder = std::make_unique<ActionLog::Recorder>();
+    }
     m_playerManager = std::make_unique<PlayerManager>();
-    m_wsServer = std::make_unique<WebSocketServer>(port);
+    m_wsServer = std::make_unique<WebSocketServer>(port, serviceThreads);
     
     // Pass WebSocketServer to components that need it
     m_matchmakingSystem = std::make_unique<MatchmakingSystem>(m_playerManager.get(), m_wsServer.get());
     m_chatSystem = std::make_unique<ChatSystem>(m_playerManager.get(), m_wsServer.get());
-    m_gameStateManager = std::make_unique<GameStateManager>(m_playerManager.get(), m_wsServer.get());
     
+    if (worldThreads == 0) {
+        worldThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    m_worldScheduler = std::make_unique<WorldScheduler>(worldThreads);
+    m_lobbyWorld = createWorld("");
+    m_worldScheduler->addWorld("", m_lobbyWorld);
+    
+    m_matchmakingSystem->setOnMatchCreated([this](const Match& match) { onMatchCreated(match); });
+    m_matchmakingSystem->setOnMatchEnded([this](const std::string& matchId) { onMatchEnded(matchId); });
+    
+    // Connections are identified by their player's slot map handle
+    m_wsServer->setIdAllocator([this]() { return m_playerManager->addPlayer(); });
     m_wsServer->setOnConnect([this](uint64_t id) { onPlayerConnected(id); });
     m_wsServer->setOnDisconnect([this](uint64_t id) { onPlayerDisconnected(id); });
-    m_wsServer->setOnMessage([this](uint64_t id, const std::string& msg) { handleMessage(id, msg); });
+    m_wsServer->setOnMessage([this](uint64_t id, char* data, size_t length) { handleMessage(id, data, length); });
+    m_wsServer->setOnBinaryMessage([this](uint64_t id, char* data, size_t length) { handleBinaryMessage(id, data, length); });
+    m_wsServer->setOnMetrics([this]() { return renderMetrics(); });
 }
 
 GameServer::~GameServer() {
@@ -30,6 +72,12 @@ GameServer::~GameServer() {
 
 void GameServer::run() {
     m_running = true;
+    m_worldScheduler->start();
+    m_matchmakingSystem->start(m_matchmakingInterval);
+    m_chatSystem->start(std::chrono::milliseconds(CHAT_FLUSH_INTERVAL_MS));
+    if (m_recorder) {
+        m_recorder->start(std::chrono::milliseconds(RECORDER_FLUSH_INTERVAL_MS));
+    }
     m_gameLoopThread = std::thread(&GameServer::gameLoop, this);
     m_wsServer->run();
 }
@@ -41,84 +89,454 @@ void GameServer::stop() {
         if (m_gameLoopThread.joinable()) {
             m_gameLoopThread.join();
         }
+        m_matchmakingSystem->stop();
+        m_chatSystem->stop();
+        m_worldScheduler->stop();
+        if (m_recorder) {
+            m_recorder->stop();
+        }
     }
 }
 
+void GameServer::requestStop() {
+    m_wsServer->stop();
+}
+
 void GameServer::gameLoop() {
-    const int TICK_RATE = 120; // Increased to 120 ticks per second for lower latency
-    const auto TICK_DURATION = std::chrono::microseconds(1000000 / TICK_RATE);
-    
+    // World simulation runs on the WorldScheduler workers and matchmaking on its own
+    // thread; this loop sets up the worlds for matches as they are formed
     while (m_running) {
-        auto start = std::chrono::steady_clock::now();
-        
-        // Update game state
-        m_gameStateManager->tick();
-        
-        // Process matchmaking
-        m_matchmakingSystem->process();
-        
-        // Send state updates to clients (handled inside tick() with dirty check)
-        // m_gameStateManager->broadcastStateUpdates();
-        
-        auto end = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-        auto sleepTime = TICK_DURATION - elapsed;
-        
-        if (sleepTime.count() > 0) {
-            std::this_thread::sleep_for(sleepTime);
-        }
+        m_matchmakingSystem->dispatchMatches(std::chrono::milliseconds(100));
+        expireSuspendedPlayers();
     }
 }
 
 void GameServer::onPlayerConnected(uint64_t playerId) {
-    std::cout << "[GameServer] Player " << playerId << " connected" << std::endl;
-    m_playerManager->addPlayer(playerId);
+    LOG_INFO("GameServer", "Player {} connected", playerId);
     
     Json::Value response;
     response["type"] = "connected";
     response["playerId"] = static_cast<Json::UInt64>(playerId);
-    response["serverTime"] = static_cast<Json::UInt64>(m_gameStateManager->getServerTime());
+    response["serverTime"] = static_cast<Json::UInt64>(m_lobbyWorld->getServerTime());
+    std::string token = m_reconnectGrace.count() > 0 ? issueReconnectToken(playerId) : "";
+    if (!token.empty()) {
+        response["reconnectToken"] = token;
+    }
     
     m_wsServer->send(playerId, response.toStyledString());
+    m_chatSystem->joinChannel(playerId, "global");
 }
 
 void GameServer::onPlayerDisconnected(uint64_t playerId) {
-    std::cout << "Player " << playerId << " disconnected" << std::endl;
-    m_gameStateManager->removePlayer(playerId);
+    LOG_INFO("GameServer", "Player {} disconnected", playerId);
+    
+    if (m_reconnectGrace.count() > 0) {
+        {
+            std::lock_guard<std::mutex> lock(m_sessionsMutex);
+            m_suspendedPlayers[playerId] = std::chrono::steady_clock::now() + m_reconnectGrace;
+        }
+        // Keep the world and match seat, but don't match a player who is away
+        m_matchmakingSystem->cancelQueue(playerId);
+        LOG_INFO("GameServer", "Holding player {} for {}ms", playerId, m_reconnectGrace.count());
+        return;
+    }
+    releasePlayer(playerId);
+}
+
+void GameServer::handleResume(uint64_t clientId, std::string_view token, uint64_t lastTick) {
+    uint64_t playerId = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        if (token.size() == TOKEN_SELECTOR_CHARS * 2) {
+            auto it = m_reconnectTokens.find(std::string(token.substr(0, TOKEN_SELECTOR_CHARS)));
+            if (it != m_reconnectTokens.end() && it->second.playerId != clientId &&
+                CRYPTO_memcmp(it->second.verifier.data(), token.data() + TOKEN_SELECTOR_CHARS, TOKEN_SELECTOR_CHARS) == 0) {
+                playerId = it->second.playerId;
+            }
+        }
+    }
+    
+    // Take over the player's ID first, so nothing is released if the connection went away meanwhile
+    if (playerId == 0 || !m_wsServer->rebindClient(clientId, playerId)) {
+        Json::Value response;
+        response["type"] = "resume_failed";
+        m_wsServer->send(clientId, response.toStyledString());
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        m_suspendedPlayers.erase(playerId);
+    }
+    std::string newToken = issueReconnectToken(playerId); // Retires the one just used
+    releasePlayer(clientId); // The connection's own, never used identity
+    
+    auto world = getPlayerWorld(playerId);
+    m_wsServer->setClientRoom(playerId, world->getRoomId());
+    world->resumePlayer(playerId, lastTick);
+    
+    Json::Value response;
+    response["type"] = "resumed";
+    response["playerId"] = static_cast<Json::UInt64>(playerId);
+    if (!newToken.empty()) {
+        response["reconnectToken"] = newToken;
+    }
+    response["matchId"] = world->getRoomId();
+    response["serverTime"] = static_cast<Json::UInt64>(m_lobbyWorld->getServerTime());
+    m_wsServer->send(playerId, response.toStyledString());
+    
+    // Chat backlog covers what was said while away
+    m_chatSystem->joinChannel(playerId, "global");
+    if (world != m_lobbyWorld) {
+        m_chatSystem->joinChannel(playerId, world->getRoomId());
+    }
+    
+    LOG_INFO("GameServer", "Player {} resumed from tick {}", playerId, lastTick);
+}
+
+std::string GameServer::issueReconnectToken(uint64_t playerId) {
+    std::lock_guard<std::mutex> lock(m_sessionsMutex);
+    auto previous = m_playerTokens.find(playerId);
+    if (previous != m_playerTokens.end()) {
+        m_reconnectTokens.erase(previous->second);
+        m_playerTokens.erase(previous);
+    }
+    
+    // A general-purpose PRNG would let a client that sees enough tokens predict the next
+    std::string token;
+    do {
+        unsigned char bytes[TOKEN_SELECTOR_CHARS];
+        if (RAND_bytes(bytes, sizeof(bytes)) != 1) {
+            LOG_ERROR("GameServer", "No reconnect token for player {}: system RNG unavailable", playerId);
+            return "";
+        }
+        char hex[TOKEN_SELECTOR_CHARS * 2 + 1];
+        for (size_t i = 0; i < sizeof(bytes); ++i) {
+            std::snprintf(hex + i * 2, 3, "%02x", bytes[i]);
+        }
+        token.assign(hex, TOKEN_SELECTOR_CHARS * 2);
+    } while (m_reconnectTokens.count(token.substr(0, TOKEN_SELECTOR_CHARS)) > 0);
+    
+    std::string selector = token.substr(0, TOKEN_SELECTOR_CHARS);
+    m_playerTokens[playerId] = selector;
+    m_reconnectTokens[selector] = ReconnectToken{playerId, token.substr(TOKEN_SELECTOR_CHARS)};
+    return token;
+}
+
+void GameServer::expireSuspendedPlayers() {
+    std::vector<uint64_t> expired;
+    {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        auto now = std::chrono::steady_clock::now();
+        for (auto it = m_suspendedPlayers.begin(); it != m_suspendedPlayers.end();) {
+            if (it->second <= now) {
+                // A resume can race the old socket's disconnect; never drop a live player
+                if (!m_wsServer->isConnected(it->first)) {
+                    expired.push_back(it->first);
+                }
+                it = m_suspendedPlayers.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    
+    for (uint64_t playerId : expired) {
+        LOG_INFO("GameServer", "Player {} did not reconnect", playerId);
+        releasePlayer(playerId);
+    }
+}
+
+void GameServer::releasePlayer(uint64_t playerId) {
+    {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        auto it = m_playerTokens.find(playerId);
+        if (it != m_playerTokens.end()) {
+            m_reconnectTokens.erase(it->second);
+            m_playerTokens.erase(it);
+        }
+        m_suspendedPlayers.erase(playerId);
+    }
+    
+    // Leave the match first: a match being set up only seats players still in it
     m_matchmakingSystem->removePlayer(playerId);
+    {
+        // Despawn under the lock that seated the player, so it can't overtake the spawn
+        std::lock_guard<std::mutex> lock(m_playerWorldsMutex);
+        auto it = m_playerWorlds.find(playerId);
+        (it != m_playerWorlds.end() ? it->second : m_lobbyWorld)->removePlayer(playerId);
+        if (it != m_playerWorlds.end()) {
+            m_playerWorlds.erase(it);
+        }
+    }
     m_chatSystem->removePlayer(playerId);
     m_playerManager->removePlayer(playerId);
 }
 
-void GameServer::handleMessage(uint64_t playerId, const std::string& message) {
-    Json::Value root;
-    Json::Reader reader;
+std::shared_ptr<GameStateManager> GameServer::createWorld(const std::string& roomId) {
+    auto world = std::make_shared<GameStateManager>(m_playerManager.get(), m_wsServer.get(), roomId, m_tickRate, m_worldSize);
+    world->setMetrics(&m_tickMetrics);
     
-    if (!reader.parse(message, root)) {
-        std::cerr << "Failed to parse message from player " << playerId << std::endl;
-        return;
+    if (m_recorder) {
+        ActionLog::FileHeader header{};
+        std::memcpy(header.magic, ActionLog::MAGIC, sizeof(header.magic));
+        header.version = ActionLog::VERSION;
+        header.seed = world->getSeed();
+        header.tickRate = world->getTickRate();
+        header.worldSize = world->getWorldSize();
+        roomId.copy(header.roomId, sizeof(header.roomId) - 1);
+        
+        std::string path = m_recordDir + "/" + std::to_string(m_recordStamp) + "-" +
+                           (roomId.empty() ? "lobby" : roomId) + ".actlog";
+        world->setActionLog(m_recorder->open(path, header));
     }
+    return world;
+}
+
+void GameServer::onMatchCreated(const Match& match) {
+    auto world = createWorld(match.matchId);
+    m_worldScheduler->addWorld(match.matchId, world);
     
-    std::string type = root["type"].asString();
+    for (uint64_t playerId : match.players) {
+        {
+            // Players released since the match was dispatched have left it; releasePlayer
+            // leaves the match before it takes this lock, so none is seated after release
+            std::lock_guard<std::mutex> lock(m_playerWorldsMutex);
+            if (!m_matchmakingSystem->isPlayerInMatch(playerId, match.matchId)) {
+                continue;
+            }
+            auto it = m_playerWorlds.find(playerId);
+            std::shared_ptr<GameStateManager> previous = (it != m_playerWorlds.end()) ? it->second : m_lobbyWorld;
+            m_playerWorlds[playerId] = world;
+            previous->removePlayer(playerId);
+            world->spawnPlayer(playerId);
+        }
+        m_chatSystem->joinChannel(playerId, match.matchId);
+    }
     
-    if (type == "matchmaking_request") {
-        std::cout << "[Server] Received matchmaking request from player " << playerId << std::endl;
-        m_matchmakingSystem->queuePlayer(playerId, root);
+    LOG_INFO("GameServer", "Match {} world created with {} players ({} worlds)", match.matchId, match.players.size(),
+             m_worldScheduler->getWorldCount());
+}
+
+void GameServer::onMatchEnded(const std::string& matchId) {
+    auto world = m_worldScheduler->getWorld(matchId);
+    m_worldScheduler->removeWorld(matchId);
+    if (!world) {
+        return;
     }
-    else if (type == "chat_message") {
-        m_chatSystem->handleMessage(playerId, root);
+    
+    // Anyone still seated in the world goes back to the lobby
+    std::vector<uint64_t> returning;
+    {
+        std::lock_guard<std::mutex> lock(m_playerWorldsMutex);
+        for (auto it = m_playerWorlds.begin(); it != m_playerWorlds.end();) {
+            if (it->second == world) {
+                returning.push_back(it->first);
+                it = m_playerWorlds.erase(it);
+            } else {
+                ++it;
+            }
+        }
     }
-    else if (type == "game_action") {
-        m_gameStateManager->handlePlayerAction(playerId, root);
+    for (uint64_t playerId : returning) {
+        m_wsServer->setClientRoom(playerId, "");
     }
-    else if (type == "ping") {
-        Json::Value response;
-        response["type"] = "pong";
-        response["serverTime"] = static_cast<Json::UInt64>(m_gameStateManager->getServerTime());
-        m_wsServer->send(playerId, response.toStyledString());
+    m_wsServer->releaseRoom(matchId);
+    m_chatSystem->removeChannel(matchId);
+    
+    LOG_INFO("GameServer", "Match {} world destroyed", matchId);
+}
+
+std::shared_ptr<GameStateManager> GameServer::getPlayerWorld(uint64_t playerId) {
+    std::lock_guard<std::mutex> lock(m_playerWorldsMutex);
+    auto it = m_playerWorlds.find(playerId);
+    return it != m_playerWorlds.end() ? it->second : m_lobbyWorld;
+}
+
+void GameServer::handleMessage(uint64_t playerId, char* data, size_t length) {
+    using MessageParser::MessageType;
+    
+    MessageParser::ClientMessage message;
+    if (!MessageParser::parseClientMessage(data, length, message)) {
+        LOG_WARN("GameServer", "Failed to parse message from player {}", playerId);
+        return;
     }
-    else {
-        std::cerr << "Unknown message type: " << type << std::endl;
+    
+    switch (message.type) {
+        case MessageType::MatchmakingRequest:
+            LOG_DEBUG("GameServer", "Received matchmaking request from player {}", playerId);
+            m_matchmakingSystem->queuePlayer(playerId, std::string(message.matchmaking.gameMode),
+                                             message.matchmaking.minPlayers, message.matchmaking.maxPlayers);
+            break;
+        case MessageType::ChatMessage:
+            m_chatSystem->handleMessage(playerId, message.chat);
+            break;
+        case MessageType::GameAction:
+            getPlayerWorld(playerId)->handlePlayerAction(playerId, message.action);
+            break;
+        case MessageType::GameActions:
+            getPlayerWorld(playerId)->handlePlayerActions(playerId, message.batch.actions, message.batch.count);
+            break;
+        case MessageType::Resume:
+            handleResume(playerId, message.resume.token, message.resume.lastTick);
+            break;
+        case MessageType::Ping: {
+            if (message.ping.latency >= 0) {
+                m_playerManager->updatePlayerLatency(playerId, static_cast<float>(message.ping.latency));
+            }
+            Json::Value response;
+            response["type"] = "pong";
+            response["serverTime"] = static_cast<Json::UInt64>(m_lobbyWorld->getServerTime());
+            m_wsServer->send(playerId, response.toStyledString());
+            break;
+        }
+        default:
+            LOG_WARN("GameServer", "Unknown message type: {}", message.typeName);
+            break;
     }
 }
 
+void GameServer::handleBinaryMessage(uint64_t playerId, char* data, size_t length) {
+    uint64_t tick = 0;
+    if (StateCodec::decodeStateAck(std::string_view(data, length), tick)) {
+        getPlayerWorld(playerId)->acknowledgeState(playerId, tick);
+    } else {
+        LOG_WARN("GameServer", "Unknown binary message from player {}", playerId);
+    }
+}
+
+std::string GameServer::renderMetrics() {
+    Metrics::TextWriter out;
+    
+    out.header("game_phase_duration_seconds", "histogram", "Time spent in each phase of a world tick, and in matchmaking passes");
+    out.histogram("game_phase_duration_seconds", m_tickMetrics.processActions, "phase=\"processActions\"");
+    out.histogram("game_phase_duration_seconds", m_tickMetrics.simulate, "phase=\"simulate\"");
+    out.histogram("game_phase_duration_seconds", m_tickMetrics.broadcast, "phase=\"broadcast\"");
+    out.histogram("game_phase_duration_seconds", m_tickMetrics.snapshot, "phase=\"snapshot\"");
+    out.histogram("game_phase_duration_seconds", m_matchmakingSystem->getBatchDurations(), "phase=\"matchmaking\"");
+    
+    // Tick scheduling
+    TickStats ticks = m_worldScheduler->getStats();
+    out.header("game_ticks_total", "counter", "World ticks run");
+    out.sample("game_ticks_total", ticks.ticks);
+    out.header("game_catchup_ticks_total", "counter", "Ticks run back to back by a world that had fallen behind");
+    out.sample("game_catchup_ticks_total", ticks.catchUpTicks);
+    out.header("game_skipped_ticks_total", "counter", "Ticks dropped by a world too far behind");
+    out.sample("game_skipped_ticks_total", ticks.skippedTicks);
+    out.header("game_tick_overruns_total", "counter", "Ticks that finished after the next deadline");
+    out.sample("game_tick_overruns_total", ticks.overruns);
+    out.header("game_tick_jitter_seconds", "summary", "Delay from deadline to tick start");
+    out.sample("game_tick_jitter_seconds_sum", ticks.jitterTotalUs / 1e6);
+    out.sample("game_tick_jitter_seconds_count", ticks.jitterSamples);
+    out.header("game_tick_jitter_max_seconds", "gauge", "Largest delay from deadline to tick start");
+    out.sample("game_tick_jitter_max_seconds", ticks.jitterMaxUs / 1e6);
+    
+    // Worlds and their action queues
+    uint64_t worlds = 0;
+    uint64_t queuedActions = 0;
+    uint64_t maxQueuedActions = 0;
+    m_worldScheduler->forEachWorld([&](const GameStateManager& world) {
+        uint64_t depth = world.getActionQueueDepth();
+        ++worlds;
+        queuedActions += depth;
+        maxQueuedActions = std::max(maxQueuedActions, depth);
+    });
+    out.header("game_worlds", "gauge", "Worlds being ticked, including the lobby");
+    out.sample("game_worlds", worlds);
+    out.header("game_action_queue_depth", "gauge", "Actions waiting for their world's next tick");
+    out.sample("game_action_queue_depth", queuedActions);
+    out.header("game_action_queue_depth_max", "gauge", "Deepest action queue of any world");
+    out.sample("game_action_queue_depth_max", maxQueuedActions);
+    out.header("game_dropped_actions_total", "counter", "Actions dropped because a world's queue was full");
+    out.sample("game_dropped_actions_total", m_tickMetrics.droppedActions.value());
+    out.header("game_rewinds_total", "counter", "Rollbacks to apply late actions");
+    out.sample("game_rewinds_total", m_tickMetrics.rewinds.value());
+    out.header("game_resimulated_ticks_total", "counter", "Ticks simulated again after a rollback");
+    out.sample("game_resimulated_ticks_total", m_tickMetrics.resimulatedTicks.value());
+    
+    // Connections and outbound queues: totals over every connection, but per-client
+    // series only for the deepest non-empty queues, so the label set stays bounded
+    std::vector<WebSocketServer::QueueStats> queues = m_wsServer->getQueueStats();
+    uint64_t queuedMessages = 0;
+    uint64_t queuedBytes = 0;
+    for (const auto& queue : queues) {
+        queuedMessages += queue.queuedMessages;
+        queuedBytes += queue.queuedBytes;
+    }
+    size_t reported = std::min(queues.size(), REPORTED_SESSION_QUEUES);
+    std::partial_sort(queues.begin(), queues.begin() + reported, queues.end(),
+                      [](const WebSocketServer::QueueStats& a, const WebSocketServer::QueueStats& b) {
+                          return a.queuedBytes > b.queuedBytes;
+                      });
+    while (reported > 0 && queues[reported - 1].queuedBytes == 0) {
+        --reported;
+    }
+    out.header("game_session_queued_bytes", "gauge", "Bytes waiting in the send queue of one of the 10 deepest connections");
+    for (size_t i = 0; i < reported; ++i) {
+        out.sample("game_session_queued_bytes", static_cast<uint64_t>(queues[i].queuedBytes),
+                   "client=\"" + std::to_string(queues[i].clientId) + "\"");
+    }
+    out.header("game_session_queued_messages", "gauge", "Frames waiting in the send queue of one of the 10 deepest connections");
+    for (size_t i = 0; i < reported; ++i) {
+        out.sample("game_session_queued_messages", static_cast<uint64_t>(queues[i].queuedMessages),
+                   "client=\"" + std::to_string(queues[i].clientId) + "\"");
+    }
+    out.header("game_session_queued_bytes_max", "gauge", "Deepest send queue of any connection, in bytes");
+    out.sample("game_session_queued_bytes_max", reported > 0 ? static_cast<uint64_t>(queues[0].queuedBytes) : uint64_t(0));
+    out.header("game_queued_bytes", "gauge", "Bytes waiting in all send queues");
+    out.sample("game_queued_bytes", queuedBytes);
+    out.header("game_queued_messages", "gauge", "Frames waiting in all send queues");
+    out.sample("game_queued_messages", queuedMessages);
+    out.header("game_superseded_frames_total", "counter", "State frames replaced in a queue by a newer one");
+    out.sample("game_superseded_frames_total", m_wsServer->getSupersededFrameCount());
+    out.header("game_evictions_total", "counter", "Connections closed for falling too far behind");
+    out.sample("game_evictions_total", m_wsServer->getEvictionCount());
+    out.header("game_frames_received_total", "counter", "WebSocket messages received");
+    out.sample("game_frames_received_total", m_wsServer->getFramesIn());
+    out.header("game_bytes_received_total", "counter", "WebSocket payload bytes received");
+    out.sample("game_bytes_received_total", m_wsServer->getBytesIn());
+    out.header("game_frames_sent_total", "counter", "WebSocket frames written");
+    out.sample("game_frames_sent_total", m_wsServer->getFramesOut());
+    out.header("game_bytes_sent_total", "counter", "WebSocket payload bytes written");
+    out.sample("game_bytes_sent_total", m_wsServer->getBytesOut());
+    out.header("game_connections", "gauge", "Open WebSocket connections");
+    out.sample("game_connections", static_cast<uint64_t>(m_wsServer->getClientCount()));
+    out.header("game_players", "gauge", "Known players, including suspended ones");
+    out.sample("game_players", static_cast<uint64_t>(m_playerManager->getPlayerCount()));
+    size_t suspended;
+    {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        suspended = m_suspendedPlayers.size();
+    }
+    out.header("game_suspended_players", "gauge", "Dropped players waiting to resume");
+    out.sample("game_suspended_players", static_cast<uint64_t>(suspended));
+    
+    // Matchmaking
+    MatchmakingStats matchmaking = m_matchmakingSystem->getStats();
+    out.header("game_matchmaking_queued_players", "gauge", "Players waiting for a match");
+    for (const auto& mode : matchmaking.queuedByGameMode) {
+        out.sample("game_matchmaking_queued_players", static_cast<uint64_t>(mode.second),
+                   Metrics::TextWriter::label("game_mode", mode.first));
+    }
+    out.header("game_matches_active", "gauge", "Matches in progress");
+    out.sample("game_matches_active", static_cast<uint64_t>(matchmaking.activeMatches));
+    out.header("game_matches_pending", "gauge", "Matches formed but not yet set up");
+    out.sample("game_matches_pending", static_cast<uint64_t>(matchmaking.pendingMatches));
+    out.header("game_matches_formed_total", "counter", "Matches formed");
+    out.sample("game_matches_formed_total", matchmaking.matchesFormed);
+    out.header("game_time_to_match_seconds", "summary", "Queue time of recently matched players, by quantile");
+    out.sample("game_time_to_match_seconds", matchmaking.timeToMatchP50Ms / 1e3, "quantile=\"0.5\"");
+    out.sample("game_time_to_match_seconds", matchmaking.timeToMatchP90Ms / 1e3, "quantile=\"0.9\"");
+    out.sample("game_time_to_match_seconds", matchmaking.timeToMatchP99Ms / 1e3, "quantile=\"0.99\"");
+    
+    // Chat
+    out.header("game_chat_rate_limited_total", "counter", "Chat messages rejected by the rate limiter");
+    out.sample("game_chat_rate_limited_total", m_chatSystem->getRateLimitedCount());
+    out.header("game_chat_suppressed_total", "counter", "Chat messages dropped as repeats of the sender's previous message");
+    out.sample("game_chat_suppressed_total", m_chatSystem->getSuppressedCount());
+    
+    out.header("game_log_dropped_total", "counter", "Log records dropped because a thread's log ring was full");
+    out.sample("game_log_dropped_total", Log::droppedCount());
+    
+    return out.str();
+}
@@ -3,6 +3,12 @@
 #include <memory>
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "Metrics.h"
 
 // Forward declarations to avoid circular dependencies
 class WebSocketServer;
@@ -10,27 +16,74 @@ class GameStateManager;
 class MatchmakingSystem;
 class ChatSystem;
 class PlayerManager;
+class WorldScheduler;
+struct Match;
+namespace ActionLog { class Recorder; }
 
 class GameServer {
 public:
-    GameServer(int port);
+    // worldThreads 0 = one per hardware thread; tickRate is per second for every world;
+    // matchmakingIntervalMs is the time between matchmaking passes; worldSize is the side
+    // of every world in cells; reconnectGraceMs is how long a dropped player's session
+    // can be resumed (negative disables resumption). 0 = default for any of them.
+    // A non-empty recordDir records every world's actions there for GameServerReplay
+    GameServer(int port, size_t worldThreads = 0, int serviceThreads = 1, int tickRate = 0, int matchmakingIntervalMs = 0,
+               int worldSize = 0, int reconnectGraceMs = 0, const std::string& recordDir = "");
     ~GameServer();
     
     void run();
     void stop();
-    
+    void requestStop(); // Async-signal-safe: makes run() return; the caller then calls stop()
+
 private:
     std::unique_ptr<WebSocketServer> m_wsServer;
-    std::unique_ptr<GameStateManager> m_gameStateManager;
+    std::unique_ptr<WorldScheduler> m_worldScheduler;
+    std::shared_ptr<GameStateManager> m_lobbyWorld; // Players not in a match
+    int m_tickRate;
+    int m_worldSize;
+    Metrics::TickMetrics m_tickMetrics; // Shared by every world
+    std::unique_ptr<ActionLog::Recorder> m_recorder; // Null unless recording
+    std::string m_recordDir;
+    uint64_t m_recordStamp; // Server start, in Unix seconds; prefixes recording names
+    std::chrono::milliseconds m_matchmakingInterval;
+    
+    // Which world receives each player's actions; absent = lobby
+    std::unordered_map<uint64_t, std::shared_ptr<GameStateManager>> m_playerWorlds;
+    std::mutex m_playerWorldsMutex;
     std::unique_ptr<MatchmakingSystem> m_matchmakingSystem;
     std::unique_ptr<ChatSystem> m_chatSystem;
     std::unique_ptr<PlayerManager> m_playerManager;
     
+    // Session resumption: each connection gets a reconnect token. A dropped player keeps
+    // its world, entity and match seat for the grace period, and a new connection that
+    // presents the token takes the player over. Tokens are single use: 128 bits from
+    // RAND_bytes, a selector half used as the lookup key and a verifier half compared
+    // in constant time, so lookup timing says nothing about the secret.
+    struct ReconnectToken {
+        uint64_t playerId;
+        std::string verifier;
+    };
+    std::unordered_map<std::string, ReconnectToken> m_reconnectTokens; // Selector -> token
+    std::unordered_map<uint64_t, std::string> m_playerTokens;           // Player -> selector
+    std::unordered_map<uint64_t, std::chrono::steady_clock::time_point> m_suspendedPlayers; // Player -> expiry
+    std::mutex m_sessionsMutex;
+    std::chrono::milliseconds m_reconnectGrace; // 0 = disabled
+    
     std::thread m_gameLoopThread;
     std::atomic<bool> m_running;
     
     void gameLoop();
-    void handleMessage(uint64_t playerId, const std::string& message);
+    void handleMessage(uint64_t playerId, char* data, size_t length); // Parses in place
+    void handleBinaryMessage(uint64_t playerId, char* data, size_t length);
     void onPlayerConnected(uint64_t playerId);
     void onPlayerDisconnected(uint64_t playerId);
+    void handleResume(uint64_t clientId, std::string_view token, uint64_t lastTick);
+    std::string issueReconnectToken(uint64_t playerId); // "" if the system RNG failed
+    void releasePlayer(uint64_t playerId); // Removes the player from every system
+    void expireSuspendedPlayers();
+    std::shared_ptr<GameStateManager> createWorld(const std::string& roomId);
+    void onMatchCreated(const Match& match);
+    void onMatchEnded(const std::string& matchId);
+    std::shared_ptr<GameStateManager> getPlayerWorld(uint64_t playerId);
+    std::string renderMetrics(); // Prometheus text exposition, sampled at scrape time
 };
@@ -0,0 +1,552 @@
+// Load generator: drives a running GameServer with WebSocket bot clients over
+// loopback and prints a JSON report (throughput, tick overruns, latency).
+//
+//   ./GameServerBench --port 8080 --bots 2000 --threads 4 --duration 30
+//
+// Each bot connects, spawns, optionally queues for matchmaking and then sends a
+// weighted mix of moves, pings and chat at --rate messages per second. By default
+// bots speak "game-binary" and ack every state delta like the real clients do.
+#include "StateCodec.h"
+#include <libwebsockets.h>
+#include <json/json.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstring>
+#include <signal.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchConfig {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    int bots = 1000;
+    int threads = 2;
+    int durationSec = 30;
+    int warmupSec = 5;
+    double rate = 10.0;       // Messages per second per bot
+    double pingRatio = 0.1;   // Share of messages that are pings
+    double chatRatio = 0.01;  // Share that are global chat (fans out to every bot)
+    bool matchmaking = true;  // Queue every bot for a match after spawning
+    bool binary = true;       // "game-binary" or "game-websocket"
+    int connectRate = 500;    // New connections per second during ramp-up
+    uint32_t seed = 1;
+};
+
+enum SentKind { SENT_SPAWN, SENT_MATCHMAKING, SENT_MOVE, SENT_PING, SENT_CHAT, SENT_ACK, SENT_KIND_COUNT };
+const char* SENT_NAMES[SENT_KIND_COUNT] = {"spawn", "matchmaking", "move", "ping", "chat", "ack"};
+
+std::atomic<bool> g_running(true);
+std::atomic<bool> g_measuring(false);
+
+struct BenchThread;
+
+struct Outgoing {
+    std::string data;
+    bool binary;
+};
+
+struct Bot {
+    int index = 0;
+    BenchThread* thread = nullptr;
+    struct lws* wsi = nullptr;
+    bool connected = false;
+    uint64_t playerId = 0;
+    uint64_t nextActionId = 1;
+    std::deque<Outgoing> outgoing;
+    std::deque<Clock::time_point> pendingPings; // Pongs come back in order
+    std::string partialMessage;
+
+    // Tick continuity on this connection's state stream
+    uint64_t lastTick = 0;
+    uint64_t intervals = 0;
+    uint64_t consecutiveIntervals = 0;
+    uint64_t skippedTicks = 0;
+};
+
+// Per service thread; only touched by that thread until it has been joined
+struct Stats {
+    uint64_t sent[SENT_KIND_COUNT] = {};
+    uint64_t received = 0;
+    uint64_t receivedBytes = 0;
+    uint64_t stateUpdates = 0;
+    uint64_t pongs = 0;
+    uint64_t chatMessages = 0;
+    uint64_t matchesFound = 0;
+    uint64_t connectErrors = 0;
+    uint64_t disconnects = 0;
+    std::vector<uint32_t> pingUs;
+    std::vector<uint32_t> chatUs;
+    std::vector<uint32_t> stateAgeUs; // Tick start on the server to receipt; same-host clocks only
+};
+
+struct BenchThread {
+    const BenchConfig* config = nullptr;
+    struct lws_context* context = nullptr;
+    std::vector<std::unique_ptr<Bot>> bots;
+    size_t nextToConnect = 0;
+    std::atomic<size_t> connectAllowance{0}; // Raised by the ramp on the main thread
+    size_t connected = 0;
+    std::mt19937 rng;
+    Stats stats;
+    std::vector<unsigned char> writeBuffer;
+    std::thread thread;
+};
+
+uint64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now().time_since_epoch()).count();
+}
+
+uint64_t nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now().time_since_epoch()).count();
+}
+
+void recordLatency(std::vector<uint32_t>& samples, uint64_t micros) {
+    samples.push_back(static_cast<uint32_t>(std::min<uint64_t>(micros, UINT32_MAX)));
+}
+
+void send(Bot& bot, SentKind kind, std::string data, bool binary = false) {
+    bot.outgoing.push_back(Outgoing{std::move(data), binary});
+    if (g_measuring) {
+        bot.thread->stats.sent[kind]++;
+    }
+    lws_callback_on_writable(bot.wsi);
+}
+
+void sendAction(Bot& bot, const char* actionType, int dx, int dy) {
+    uint64_t actionId = bot.nextActionId++;
+    std::string message = "{\"type\":\"game_action\",\"actionType\":\"";
+    message += actionType;
+    message += "\",\"actionId\":" + std::to_string(actionId) +
+               ",\"timestamp\":" + std::to_string(nowMs()) +
+               ",\"sequenceNumber\":" + std::to_string(actionId) +
+               ",\"data\":{\"dx\":" + std::to_string(dx) + ",\"dy\":" + std::to_string(dy) + "}}";
+    send(bot, actionType[0] == 's' ? SENT_SPAWN : SENT_MOVE, std::move(message));
+}
+
+void scheduleNext(Bot& bot) {
+    const BenchConfig& config = *bot.thread->config;
+    std::uniform_real_distribution<double> jitter(0.5, 1.5);
+    int64_t interval = static_cast<int64_t>(1000000.0 / config.rate * jitter(bot.thread->rng));
+    lws_set_timer_usecs(bot.wsi, std::max<int64_t>(interval, 1));
+}
+
+void onBotEstablished(Bot& bot) {
+    BenchThread& thread = *bot.thread;
+    bot.connected = true;
+    thread.connected++;
+
+    sendAction(bot, "spawn", 0, 0);
+    if (thread.config->matchmaking) {
+        send(bot, SENT_MATCHMAKING, "{\"type\":\"matchmaking_request\",\"gameMode\":\"bench\",\"minPlayers\":2,\"maxPlayers\":4}");
+    }
+    scheduleNext(bot);
+}
+
+void onBotTimer(Bot& bot) {
+    BenchThread& thread = *bot.thread;
+    const BenchConfig& config = *thread.config;
+    std::uniform_real_distribution<double> roll(0.0, 1.0);
+    double r = roll(thread.rng);
+
+    if (r < config.pingRatio) {
+        bot.pendingPings.push_back(Clock::now());
+        send(bot, SENT_PING, "{\"type\":\"ping\"}");
+    } else if (r < config.pingRatio + config.chatRatio) {
+        // The send time rides in the text so the bot can time its own echo
+        send(bot, SENT_CHAT, "{\"type\":\"chat_message\",\"channel\":\"global\",\"message\":\"bench " +
+                             std::to_string(bot.index) + " " + std::to_string(nowUs()) + "\"}");
+    } else {
+        static const int DIRECTIONS[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+        const int* direction = DIRECTIONS[thread.rng() % 4];
+        sendAction(bot, "move", direction[0], direction[1]);
+    }
+    scheduleNext(bot);
+}
+
+void onStateTick(Bot& bot, uint64_t tick, uint64_t serverTime) {
+    Stats& stats = bot.thread->stats;
+    stats.stateUpdates++;
+    uint64_t receivedAt = nowMs();
+    recordLatency(stats.stateAgeUs, receivedAt > serverTime ? (receivedAt - serverTime) * 1000 : 0);
+
+    if (bot.lastTick != 0 && tick > bot.lastTick) {
+        bot.intervals++;
+        if (tick == bot.lastTick + 1) {
+            bot.consecutiveIntervals++;
+        } else {
+            bot.skippedTicks += tick - bot.lastTick - 1;
+        }
+    }
+    bot.lastTick = tick;
+}
+
+void onBotText(Bot& bot, const char* data, size_t length) {
+    Json::Value root;
+    std::string errors;
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    if (!reader->parse(data, data + length, &root, &errors)) {
+        return;
+    }
+
+    Stats& stats = bot.thread->stats;
+    const std::string type = root.get("type", "").asString();
+    if (type == "connected") {
+        bot.playerId = root.get("playerId", 0).asUInt64();
+    } else if (type == "pong") {
+        if (!bot.pendingPings.empty()) {
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - bot.pendingPings.front());
+            bot.pendingPings.pop_front();
+            if (g_measuring) {
+                stats.pongs++;
+                recordLatency(stats.pingUs, elapsed.count());
+            }
+        }
+    } else if (type == "chat_batch") {
+        if (!g_measuring) return;
+        for (const Json::Value& entry : root["messages"]) {
+            stats.chatMessages++;
+            int index = -1;
+            unsigned long long sentUs = 0;
+            if (sscanf(entry.get("message", "").asCString(), "bench %d %llu", &index, &sentUs) == 2 && index == bot.index) {
+                recordLatency(stats.chatUs, nowUs() - sentUs);
+            }
+        }
+    } else if (type == "match_found") {
+        if (g_measuring) stats.matchesFound++;
+    } else if (type == "state_update") {
+        if (g_measuring) onStateTick(bot, root.get("tick", 0).asUInt64(), root.get("serverTime", 0).asUInt64());
+    }
+}
+
+void onBotBinary(Bot& bot, const char* data, size_t length) {
+    uint64_t tick, serverTime, baseTick;
+    if (!StateCodec::decodeStateDeltaHeader(std::string_view(data, length), tick, serverTime, baseTick)) {
+        return;
+    }
+    if (g_measuring) {
+        onStateTick(bot, tick, serverTime);
+    }
+    send(bot, SENT_ACK, StateCodec::encodeStateAck(tick), true);
+}
+
+void connectPending(BenchThread& thread) {
+    size_t allowance = std::min(thread.connectAllowance.load(), thread.bots.size());
+    for (; thread.nextToConnect < allowance; ++thread.nextToConnect) {
+        Bot& bot = *thread.bots[thread.nextToConnect];
+
+        struct lws_client_connect_info info;
+        memset(&info, 0, sizeof(info));
+        info.context = thread.context;
+        info.address = thread.config->host.c_str();
+        info.port = thread.config->port;
+        info.path = "/";
+        info.host = info.address;
+        info.origin = info.address;
+        info.protocol = thread.config->binary ? "game-binary" : "game-websocket";
+        info.userdata = &bot;
+        info.pwsi = &bot.wsi;
+
+        if (!lws_client_connect_via_info(&info)) {
+            thread.stats.connectErrors++;
+        }
+    }
+}
+
+int callback_bot(struct lws* wsi, enum lws_callback_reasons reason, void* user, void* in, size_t len) {
+    Bot* bot = (Bot*)user;
+
+    switch (reason) {
+        case LWS_CALLBACK_EVENT_WAIT_CANCELLED: {
+            BenchThread* thread = (BenchThread*)lws_context_user(lws_get_context(wsi));
+            if (thread) connectPending(*thread);
+            break;
+        }
+
+        case LWS_CALLBACK_CLIENT_ESTABLISHED:
+            if (bot) onBotEstablished(*bot);
+            break;
+
+        case LWS_CALLBACK_CLIENT_RECEIVE: {
+            if (!bot || !in) break;
+            BenchThread& thread = *bot->thread;
+            if (g_measuring) thread.stats.receivedBytes += len;
+
+            char* data = (char*)in;
+            size_t length = len;
+            bool complete = lws_is_final_fragment(wsi) && lws_remaining_packet_payload(wsi) == 0;
+            if (!complete || !bot->partialMessage.empty()) {
+                bot->partialMessage.append(data, len);
+                if (!complete) break;
+                data = &bot->partialMessage[0];
+                length = bot->partialMessage.size();
+            }
+
+            if (g_measuring) thread.stats.received++;
+            if (lws_frame_is_binary(wsi)) {
+                onBotBinary(*bot, data, length);
+            } else {
+                onBotText(*bot, data, length);
+            }
+            bot->partialMessage.clear();
+            break;
+        }
+
+        case LWS_CALLBACK_CLIENT_WRITEABLE: {
+            if (!bot || bot->outgoing.empty()) break;
+
+            Outgoing message = std::move(bot->outgoing.front());
+            bot->outgoing.pop_front();
+
+            std::vector<unsigned char>& buffer = bot->thread->writeBuffer;
+            buffer.resize(LWS_PRE + message.data.size());
+            memcpy(buffer.data() + LWS_PRE, message.data.data(), message.data.size());
+            if (lws_write(wsi, buffer.data() + LWS_PRE, message.data.size(),
+                          message.binary ? LWS_WRITE_BINARY : LWS_WRITE_TEXT) < (int)message.data.size()) {
+                return -1;
+            }
+            if (!bot->outgoing.empty()) {
+                lws_callback_on_writable(wsi);
+            }
+            break;
+        }
+
+        case LWS_CALLBACK_TIMER:
+            if (bot && bot->connected && g_running) onBotTimer(*bot);
+            break;
+
+        case LWS_CALLBACK_CLIENT_CONNECTION_ERROR:
+            if (bot) bot->thread->stats.connectErrors++;
+            break;
+
+        case LWS_CALLBACK_CLIENT_CLOSED:
+            if (bot && bot->connected) {
+                bot->connected = false;
+                bot->thread->connected--;
+                bot->thread->stats.disconnects++;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+struct lws_protocols protocols[] = {
+    { "game-binary", callback_bot, 0, 65536 },
+    { "game-websocket", callback_bot, 0, 65536 },
+    { NULL, NULL, 0, 0 }
+};
+
+Json::Value percentiles(std::vector<uint32_t>& samples) {
+    Json::Value result;
+    result["count"] = static_cast<Json::UInt64>(samples.size());
+    if (samples.empty()) {
+        return result;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    auto at = [&samples](double quantile) {
+        size_t index = std::min(samples.size() - 1, static_cast<size_t>(quantile * samples.size()));
+        return samples[index] / 1000.0;
+    };
+    result["p50"] = at(0.50);
+    result["p99"] = at(0.99);
+    result["p999"] = at(0.999);
+    result["max"] = samples.back() / 1000.0;
+    return result;
+}
+
+bool parseArgs(int argc, char* argv[], BenchConfig& config) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || i + 1 >= argc) {
+            std::cerr << "Usage: GameServerBench [--host H] [--port P] [--bots N] [--threads T] [--duration S]\n"
+                      << "         [--warmup S] [--rate MSG/S] [--ping RATIO] [--chat RATIO] [--matchmaking 0|1]\n"
+                      << "         [--protocol binary|json] [--connect-rate CONN/S] [--seed N]" << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--host") config.host = value;
+        else if (arg == "--port") config.port = std::stoi(value);
+        else if (arg == "--bots") config.bots = std::stoi(value);
+        else if (arg == "--threads") config.threads = std::max(1, std::stoi(value));
+        else if (arg == "--duration") config.durationSec = std::stoi(value);
+        else if (arg == "--warmup") config.warmupSec = std::stoi(value);
+        else if (arg == "--rate") config.rate = std::stod(value);
+        else if (arg == "--ping") config.pingRatio = std::stod(value);
+        else if (arg == "--chat") config.chatRatio = std::stod(value);
+        else if (arg == "--matchmaking") config.matchmaking = value != "0";
+        else if (arg == "--protocol") config.binary = value != "json";
+        else if (arg == "--connect-rate") config.connectRate = std::max(1, std::stoi(value));
+        else if (arg == "--seed") config.seed = static_cast<uint32_t>(std::stoul(value));
+        else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+    return config.rate > 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    BenchConfig config;
+    if (!parseArgs(argc, argv, config)) {
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    lws_set_log_level(LLL_ERR, NULL);
+
+    std::vector<std::unique_ptr<BenchThread>> threads;
+    for (int t = 0; t < config.threads; ++t) {
+        auto thread = std::make_unique<BenchThread>();
+        thread->config = &config;
+        thread->rng.seed(config.seed + t);
+        threads.push_back(std::move(thread));
+    }
+    for (int i = 0; i < config.bots; ++i) {
+        BenchThread& thread = *threads[i % config.threads];
+        auto bot = std::make_unique<Bot>();
+        bot->index = i;
+        bot->thread = &thread;
+        thread.bots.push_back(std::move(bot));
+    }
+
+    for (auto& thread : threads) {
+        struct lws_context_creation_info info;
+        memset(&info, 0, sizeof(info));
+        info.port = CONTEXT_PORT_NO_LISTEN;
+        info.protocols = protocols;
+        info.gid = -1;
+        info.uid = -1;
+        info.user = thread.get();
+
+        thread->context = lws_create_context(&info);
+        if (!thread->context) {
+            std::cerr << "Failed to create libwebsockets client context" << std::endl;
+            return 1;
+        }
+        BenchThread* raw = thread.get();
+        thread->thread = std::thread([raw]() {
+            while (g_running) {
+                lws_service(raw->context, 0);
+            }
+        });
+    }
+
+    // Ramp connections at connectRate, then warm up, then measure
+    auto start = Clock::now();
+    auto measureStart = start + std::chrono::seconds(config.warmupSec);
+    auto measureEnd = measureStart + std::chrono::seconds(config.durationSec);
+    while (Clock::now() < measureEnd) {
+        double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        size_t target = static_cast<size_t>(elapsed * config.connectRate / config.threads) + 1;
+        for (auto& thread : threads) {
+            thread->connectAllowance = target;
+            lws_cancel_service(thread->context);
+        }
+        if (!g_measuring && Clock::now() >= measureStart) {
+            measureStart = Clock::now();
+            g_measuring = true;
+            std::cerr << "[Bench] Measuring for " << config.durationSec << "s" << std::endl;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    g_measuring = false;
+    double measuredSec = std::chrono::duration<double>(Clock::now() - measureStart).count();
+
+    g_running = false;
+    for (auto& thread : threads) {
+        lws_cancel_service(thread->context);
+        thread->thread.join();
+    }
+
+    // Merge per-thread results
+    Stats total;
+    size_t connected = 0;
+    uint64_t intervals = 0, skipped = 0, streams = 0;
+    for (auto& thread : threads) {
+        Stats& stats = thread->stats;
+        for (int k = 0; k < SENT_KIND_COUNT; ++k) total.sent[k] += stats.sent[k];
+        total.received += stats.received;
+        total.receivedBytes += stats.receivedBytes;
+        total.stateUpdates += stats.stateUpdates;
+        total.pongs += stats.pongs;
+        total.chatMessages += stats.chatMessages;
+        total.matchesFound += stats.matchesFound;
+        total.connectErrors += stats.connectErrors;
+        total.disconnects += stats.disconnects;
+        total.pingUs.insert(total.pingUs.end(), stats.pingUs.begin(), stats.pingUs.end());
+        total.chatUs.insert(total.chatUs.end(), stats.chatUs.begin(), stats.chatUs.end());
+        total.stateAgeUs.insert(total.stateAgeUs.end(), stats.stateAgeUs.begin(), stats.stateAgeUs.end());
+        connected += thread->connected;
+
+        // Worlds only broadcast on dirty ticks, so tick gaps are only meaningful on
+        // streams that normally see every tick (busy worlds)
+        for (auto& bot : thread->bots) {
+            if (bot->intervals > 0 && bot->consecutiveIntervals * 2 >= bot->intervals) {
+                streams++;
+                intervals += bot->intervals;
+                skipped += bot->skippedTicks;
+            }
+        }
+        lws_context_destroy(thread->context);
+    }
+
+    uint64_t sentTotal = 0;
+    Json::Value sent;
+    for (int k = 0; k < SENT_KIND_COUNT; ++k) {
+        sent[SENT_NAMES[k]] = static_cast<Json::UInt64>(total.sent[k]);
+        sentTotal += total.sent[k];
+    }
+    sent["total"] = static_cast<Json::UInt64>(sentTotal);
+    sent["perSec"] = sentTotal / measuredSec;
+
+    Json::Value received;
+    received["total"] = static_cast<Json::UInt64>(total.received);
+    received["perSec"] = total.received / measuredSec;
+    received["bytesPerSec"] = total.receivedBytes / measuredSec;
+    received["stateUpdates"] = static_cast<Json::UInt64>(total.stateUpdates);
+    received["pongs"] = static_cast<Json::UInt64>(total.pongs);
+    received["chatMessages"] = static_cast<Json::UInt64>(total.chatMessages);
+    received["matchesFound"] = static_cast<Json::UInt64>(total.matchesFound);
+
+    Json::Value ticks;
+    ticks["busyStreams"] = static_cast<Json::UInt64>(streams);
+    ticks["intervals"] = static_cast<Json::UInt64>(intervals);
+    ticks["skipped"] = static_cast<Json::UInt64>(skipped);
+    ticks["overrunRate"] = (intervals + skipped) > 0 ? static_cast<double>(skipped) / (intervals + skipped) : 0.0;
+
+    Json::Value latency;
+    latency["ping"] = percentiles(total.pingUs);
+    latency["chat"] = percentiles(total.chatUs);
+    latency["stateAge"] = percentiles(total.stateAgeUs);
+
+    Json::Value report;
+    report["bots"] = config.bots;
+    report["connected"] = static_cast<Json::UInt64>(connected);
+    report["connectErrors"] = static_cast<Json::UInt64>(total.connectErrors);
+    report["disconnects"] = static_cast<Json::UInt64>(total.disconnects);
+    report["protocol"] = config.binary ? "game-binary" : "game-websocket";
+    report["durationSec"] = measuredSec;
+    report["sent"] = sent;
+    report["received"] = received;
+    report["ticks"] = ticks;
+    report["latencyMs"] = latency;
+
+    std::cout << report.toStyledString();
+    return 0;
+}
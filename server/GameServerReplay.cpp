@@ -0,0 +1,208 @@
+// Headless replay: re-simulates a world recorded with the server's recordDir option
+// as fast as it will run, checks the state hash of every tick against the recording
+// and prints a JSON report of per-tick cost.
+//
+//   ./GameServerReplay recordings/1767225600-lobby.actlog --slowest 10
+//
+// The world runs without a PlayerManager or network; every recorded action is fed
+// to the tick it was taken off the queue on, exactly as the live server ordered
+// them. Exits non-zero at the first tick whose state differs from the recording.
+#include "ActionLog.h"
+#include "GameStateManager.h"
+#include "Log.h"
+#include <json/json.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct ReplayConfig {
+    std::string path;
+    int passes = 1;  // Whole-recording repeats; timings are kept from the fastest pass
+    size_t slowest = 5;
+};
+
+struct TickCost {
+    uint64_t tick;
+    uint64_t nanos;
+    size_t actions;
+    size_t entities;
+};
+
+struct PassResult {
+    std::vector<TickCost> ticks;
+    uint64_t totalNanos = 0;
+    uint64_t actions = 0;
+    uint64_t divergedTick = 0; // 0 = every hash matched
+    std::string divergence;
+};
+
+Json::Value percentiles(std::vector<uint64_t> nanos) {
+    Json::Value result;
+    if (nanos.empty()) {
+        return result;
+    }
+    std::sort(nanos.begin(), nanos.end());
+    auto at = [&nanos](double quantile) {
+        size_t index = std::min(nanos.size() - 1, static_cast<size_t>(quantile * nanos.size()));
+        return nanos[index] / 1000.0;
+    };
+    result["p50"] = at(0.50);
+    result["p90"] = at(0.90);
+    result["p99"] = at(0.99);
+    result["p999"] = at(0.999);
+    result["max"] = nanos.back() / 1000.0;
+    return result;
+}
+
+PassResult replay(const ActionLog::Reader& reader) {
+    const ActionLog::FileHeader& header = reader.header();
+    std::string roomId(header.roomId, strnlen(header.roomId, sizeof(header.roomId)));
+    GameStateManager world(nullptr, nullptr, roomId, header.tickRate, header.worldSize);
+    world.setSeed(header.seed);
+
+    PassResult result;
+    const ActionLog::Record* records = reader.records();
+    size_t first = 0; // First action record of the tick being collected
+    for (size_t i = 0; i < reader.recordCount(); ++i) {
+        const ActionLog::Record& record = records[i];
+        if (record.kind != ActionLog::RecordKind::Tick) {
+            continue;
+        }
+
+        size_t actions = i - first;
+        auto start = Clock::now();
+        uint64_t hash = world.replayTick(record.tick, record.serverTime, records + first, actions);
+        uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        first = i + 1;
+
+        result.ticks.push_back(TickCost{record.tick, nanos, actions, world.getEntityCount()});
+        result.totalNanos += nanos;
+        result.actions += actions;
+
+        if (hash != record.stateHash || world.getRngDraws() != record.rngDraws) {
+            result.divergedTick = record.tick;
+            result.divergence = hash != record.stateHash ? "state hash" : "rng draws";
+            break;
+        }
+    }
+    return result;
+}
+
+bool parseArgs(int argc, char* argv[], ReplayConfig& config) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help") {
+            break;
+        }
+        if (arg.rfind("--", 0) != 0) {
+            config.path = arg;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--passes") config.passes = std::max(1, std::stoi(value));
+        else if (arg == "--slowest") config.slowest = std::stoul(value);
+        else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+    if (config.path.empty()) {
+        std::cerr << "Usage: GameServerReplay <recording.actlog> [--passes N] [--slowest N]" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    ReplayConfig config;
+    if (!parseArgs(argc, argv, config)) {
+        return 1;
+    }
+    Log::start();
+
+    ActionLog::Reader reader;
+    std::string error;
+    if (!reader.open(config.path, error)) {
+        std::cerr << error << std::endl;
+        Log::stop();
+        return 1;
+    }
+
+    PassResult best;
+    for (int pass = 0; pass < config.passes; ++pass) {
+        PassResult result = replay(reader);
+        if (pass == 0 || result.totalNanos < best.totalNanos) {
+            best = std::move(result);
+        }
+        if (best.divergedTick != 0) {
+            break;
+        }
+    }
+    Log::stop();
+
+    const ActionLog::FileHeader& header = reader.header();
+    std::vector<uint64_t> nanos;
+    nanos.reserve(best.ticks.size());
+    size_t maxEntities = 0;
+    for (const TickCost& cost : best.ticks) {
+        nanos.push_back(cost.nanos);
+        maxEntities = std::max(maxEntities, cost.entities);
+    }
+
+    std::vector<TickCost> slowest = best.ticks;
+    size_t keep = std::min(config.slowest, slowest.size());
+    std::partial_sort(slowest.begin(), slowest.begin() + keep, slowest.end(),
+                      [](const TickCost& a, const TickCost& b) { return a.nanos > b.nanos; });
+    Json::Value slowTicks(Json::arrayValue);
+    for (size_t i = 0; i < keep; ++i) {
+        Json::Value tick;
+        tick["tick"] = static_cast<Json::UInt64>(slowest[i].tick);
+        tick["us"] = slowest[i].nanos / 1000.0;
+        tick["actions"] = static_cast<Json::UInt64>(slowest[i].actions);
+        tick["entities"] = static_cast<Json::UInt64>(slowest[i].entities);
+        slowTicks.append(tick);
+    }
+
+    // Ticks the scheduler skipped live are absent from the recording but not from its duration
+    double seconds = best.totalNanos / 1e9;
+    double recordedSeconds = best.ticks.empty() ? 0.0 :
+        static_cast<double>(best.ticks.back().tick - best.ticks.front().tick + 1) / std::max(1, header.tickRate);
+
+    Json::Value report;
+    report["recording"] = config.path;
+    report["roomId"] = std::string(header.roomId, strnlen(header.roomId, sizeof(header.roomId)));
+    report["seed"] = static_cast<Json::UInt64>(header.seed);
+    report["tickRate"] = header.tickRate;
+    report["worldSize"] = header.worldSize;
+    report["truncated"] = (header.flags & ActionLog::FLAG_TRUNCATED) != 0;
+    report["ticks"] = static_cast<Json::UInt64>(best.ticks.size());
+    report["actions"] = static_cast<Json::UInt64>(best.actions);
+    report["maxEntities"] = static_cast<Json::UInt64>(maxEntities);
+    report["replaySec"] = seconds;
+    report["recordedSec"] = recordedSeconds;
+    report["ticksPerSec"] = seconds > 0 ? best.ticks.size() / seconds : 0.0;
+    report["speedup"] = seconds > 0 ? recordedSeconds / seconds : 0.0;
+    report["tickUs"] = percentiles(nanos);
+    report["slowestTicks"] = slowTicks;
+    report["verified"] = best.divergedTick == 0;
+    if (best.divergedTick != 0) {
+        report["divergedTick"] = static_cast<Json::UInt64>(best.divergedTick);
+        report["divergence"] = best.divergence;
+    }
+
+    std::cout << report.toStyledString();
+    return best.divergedTick == 0 ? 0 : 2;
+}
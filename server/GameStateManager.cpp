@@ -1,151 +1,658 @@
 #include "GameStateManager.h"
 #include "WebSocketServer.h"
+#include "StateCodec.h"
+#include "Log.h"
 #include <json/json.h>
 #include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <random>
-#include <iostream>
+#include <map>
+#include <thread>
+#include <tuple>
 
-GameStateManager::GameStateManager(PlayerManager* playerManager, WebSocketServer* wsServer) 
-    : m_playerManager(playerManager), m_wsServer(wsServer), m_serverTime(0), m_tickCount(0), m_stateDirty(false) {
-    m_currentState["players"] = Json::Value(Json::objectValue);
-    m_currentState["entities"] = Json::Value(Json::arrayValue);
-    m_currentState["worldState"] = Json::Value(Json::objectValue);
+namespace {
+
+// Clients with the same view (and, for deltas, the same view at their baseline) get the same frame
+using ViewKey = std::tuple<int32_t, int32_t, int32_t, int32_t>;
+
+struct ViewGroup {
+    InterestGrid::Region view;
+    InterestGrid::Region baseView;
+    std::vector<uint64_t> clients;
+};
+
+} // namespace
+
+GameStateManager::GameStateManager(PlayerManager* playerManager, WebSocketServer* wsServer, const std::string& roomId,
+                                   int tickRate, int32_t worldSize) 
+    : m_playerManager(playerManager), m_wsServer(wsServer), m_roomId(roomId), m_tickRate(std::max(1, tickRate)),
+      m_worldSize(std::max<int32_t>(1, worldSize)), m_metrics(nullptr), m_seed(0), m_rngDraws(0),
+      m_serverTime(0), m_tickCount(0), m_stateDirty(false), m_forceBroadcast(false),
+      m_actionQueue(ACTION_QUEUE_CAPACITY), m_droppedActions(0), m_reportedDroppedActions(0), m_hasControlActions(false),
+      m_snapshots(SNAPSHOT_CAPACITY), m_rewinds(0), m_resimulatedTicks(0) {
+    m_room = m_wsServer ? m_wsServer->internRoom(roomId) : WebSocketServer::LOBBY_ROOM;
+    
+    std::random_device rd;
+    setSeed((static_cast<uint64_t>(rd()) << 32) | rd());
+    
+    m_heartbeatTicks = std::max(1, m_tickRate * HEARTBEAT_MS / 1000);
+    m_projectileStepTicks = static_cast<uint32_t>(std::max(1, m_tickRate / PROJECTILE_CELLS_PER_SECOND));
+    
+    // The rewind base must still be in the ring when a late action arrives
+    m_maxRewindTicks = std::clamp<uint64_t>(static_cast<uint64_t>(m_tickRate) * MAX_REWIND_MS / 1000,
+                                            MIN_REWIND_TICKS, SNAPSHOT_CAPACITY - 2);
+    m_rewindTickLimit = m_maxRewindTicks;
 }
 
 GameStateManager::~GameStateManager() {
+    if (m_actionLog) {
+        m_actionLog->finish();
+    }
+}
+
+void GameStateManager::setSeed(uint64_t seed) {
+    m_seed = seed;
+    m_rng.seed(seed);
+    m_rngDraws = 0;
 }
 
-void GameStateManager::tick() {
-    m_tickCount++;
+void GameStateManager::tick(uint64_t tickNumber) {
+    m_tickCount = tickNumber;
     m_serverTime = std::chrono::duration_cast<std::chrono::milliseconds>(
         std::chrono::steady_clock::now().time_since_epoch()).count();
+    runTick(true);
+}
+
+uint64_t GameStateManager::replayTick(uint64_t tickNumber, uint64_t serverTime, const ActionLog::Record* actions,
+                                      size_t count) {
+    m_tickCount = tickNumber;
+    m_serverTime = serverTime;
     
+    // Recorded after lag-compensation clamping, so late actions keep their original target
+    for (size_t i = 0; i < count; ++i) {
+        const ActionLog::Record& record = actions[i];
+        GameAction action;
+        action.playerId = record.playerId;
+        action.actionId = record.actionId;
+        action.timestamp = record.timestamp;
+        action.actionType = static_cast<ActionType>(record.actionType);
+        action.dx = record.dx;
+        action.dy = record.dy;
+        action.clientSequenceNumber = record.clientSequenceNumber;
+        action.clientTick = record.targetTick;
+        (record.late ? m_lateActions : m_currentActions).push_back(std::move(action));
+    }
+    
+    runTick(false);
+    return m_entities.stateHash();
+}
+
+void GameStateManager::runTick(bool drainQueue) {
     // Reset dirty flag at start of tick
     m_stateDirty = false;
     
-    processActions();
-    simulateTick();
+    // Phase timings go to the shared histograms; the clock is only read when they are attached
+    using Clock = std::chrono::steady_clock;
+    auto phaseStart = m_metrics ? Clock::now() : Clock::time_point();
+    auto endPhase = [&](Metrics::Histogram Metrics::TickMetrics::*phase) {
+        if (m_metrics) {
+            auto now = Clock::now();
+            (m_metrics->*phase).observe(std::chrono::duration_cast<std::chrono::microseconds>(now - phaseStart).count());
+            phaseStart = now;
+        }
+    };
     
-    // Always broadcast if there are actions, otherwise skip to save bandwidth
-    // In a real game, you might want a heartbeat (e.g. every 60 ticks) even if nothing changes
-    if (m_stateDirty || m_tickCount % 60 == 0) {
-        broadcastStateUpdates();
+    processActions(drainQueue);
+    endPhase(&Metrics::TickMetrics::processActions);
+    
+    simulateTick(m_tickCount, m_tickHits);
+    for (const HitEvent& hit : m_tickHits) {
+        announceHit(hit, m_tickCount);
     }
+    endPhase(&Metrics::TickMetrics::simulate);
     
-    // Create snapshot periodically (every 10 ticks)
-    if (m_tickCount % 10 == 0) {
-        createSnapshot();
+    // Always broadcast if there are actions, otherwise only a periodic heartbeat
+    bool forced = m_forceBroadcast.exchange(false);
+    bool broadcast = forced || m_stateDirty || m_tickCount % m_heartbeatTicks == 0;
+    if (broadcast) {
+        broadcastStateUpdates();
+        endPhase(&Metrics::TickMetrics::broadcast);
     }
     
-    cleanupOldSnapshots();
+    // Snapshot every tick; the ring slot is reused, and unchanged state is shared
+    createSnapshot();
+    endPhase(&Metrics::TickMetrics::snapshot);
+    
+    if (m_actionLog) {
+        ActionLog::Record record{};
+        record.kind = ActionLog::RecordKind::Tick;
+        record.tick = m_tickCount;
+        record.serverTime = m_serverTime;
+        record.stateHash = m_entities.stateHash();
+        record.rngDraws = m_rngDraws;
+        m_actionLog->append(record);
+    }
 }
 
-void GameStateManager::handlePlayerAction(uint64_t playerId, const Json::Value& actionData) {
-    GameAction action;
-    action.playerId = playerId;
-    action.actionId = actionData.get("actionId", 0).asUInt64();
-    action.timestamp = actionData.get("timestamp", static_cast<Json::UInt64>(m_serverTime)).asUInt64();
-    action.actionType = actionData.get("actionType", "").asString();
-    action.data = actionData.get("data", Json::Value());
-    action.clientSequenceNumber = actionData.get("sequenceNumber", 0).asUInt64();
+bool GameStateManager::handlePlayerAction(uint64_t playerId, const MessageParser::GameActionPayload& payload) {
+    return handlePlayerActions(playerId, &payload, 1) == 1;
+}
+
+size_t GameStateManager::handlePlayerActions(uint64_t playerId, const MessageParser::GameActionPayload* payloads,
+                                             size_t count) {
+    // The lock is only held to read and publish the player's sequence number; the tick
+    // thread takes it every tick, so validating and pushing happen outside it
+    uint64_t lastSequence;
+    {
+        std::lock_guard<std::mutex> lock(m_sequenceMutex);
+        auto it = m_playerSequenceNumbers.find(playerId);
+        lastSequence = (it != m_playerSequenceNumbers.end()) ? it->second : 0;
+    }
+    uint64_t newestSequence = lastSequence;
+    
+    size_t queued = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const MessageParser::GameActionPayload& payload = payloads[i];
+        if (payload.sequenceNumber != 0 && payload.sequenceNumber <= newestSequence) {
+            continue; // Resent for loss resilience, already queued
+        }
+        
+        GameAction action;
+        action.playerId = playerId;
+        action.actionId = payload.actionId;
+        action.timestamp = payload.hasTimestamp ? payload.timestamp : m_serverTime.load();
+        action.actionType = payload.actionType;
+        action.dx = payload.dx;
+        action.dy = payload.dy;
+        action.clientSequenceNumber = payload.sequenceNumber;
+        action.clientTick = payload.clientTick;
+        
+        // For spawn requests, we don't need strict validation on sequence
+        if (action.actionType != ActionType::Spawn && !validateAction(action)) {
+            LOG_DEBUG("GameState", "Rejected action: {} for player {}", payload.actionName, playerId);
+            continue;
+        }
+        if (!enqueueAction(std::move(action))) {
+            break; // Ring full; counted and reported from the tick thread. The rest can come again as resends
+        }
+        newestSequence = std::max(newestSequence, payload.sequenceNumber);
+        queued++;
+        LOG_DEBUG("GameState", "Queued action: {} for player {}", payload.actionName, playerId);
+    }
     
-    // For spawn requests, we don't need strict validation on sequence
-    if (action.actionType == "spawn" || validateAction(action)) {
-        std::lock_guard<std::mutex> lock(m_actionQueueMutex);
-        m_actionQueue.push(action);
-        std::cout << "[GameState] Queued action: " << action.actionType << " for player " << playerId << std::endl;
-    } else {
-        std::cout << "[GameState] REJECTED action: " << action.actionType << " for player " << playerId << std::endl;
+    if (newestSequence != lastSequence) {
+        // A concurrent batch from the same player may have published a newer one meanwhile
+        std::lock_guard<std::mutex> lock(m_sequenceMutex);
+        uint64_t& published = m_playerSequenceNumbers[playerId];
+        if (newestSequence > published) {
+            published = newestSequence;
+            m_sharedSequenceNumbers.reset();
+        }
+    }
+    return queued;
+}
+
+bool GameStateManager::enqueueAction(GameAction&& action) {
+    if (m_actionQueue.tryPush(std::move(action))) {
+        return true;
+    }
+    m_droppedActions.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void GameStateManager::enqueueControlAction(GameAction&& action) {
+    // Spawn/despawn must not be lost. The tick thread frees slots every tick, but the
+    // world may already be unscheduled (match ended) or stopping, so only wait briefly
+    for (int attempt = 0; attempt < CONTROL_PUSH_ATTEMPTS; ++attempt) {
+        if (m_actionQueue.tryPush(std::move(action))) {
+            return;
+        }
+        std::this_thread::yield();
     }
+    
+    std::lock_guard<std::mutex> lock(m_controlMutex);
+    m_controlActions.push_back(std::move(action));
+    m_hasControlActions.store(true, std::memory_order_release);
 }
 
 void GameStateManager::broadcastStateUpdates() {
-    // Create state update message
-    Json::Value update;
-    update["type"] = "state_update";
-    update["serverTime"] = static_cast<Json::UInt64>(m_serverTime);
-    update["tick"] = static_cast<Json::UInt64>(m_tickCount);
-    update["state"] = m_currentState;
+    if (!m_wsServer) {
+        return;
+    }
     
-    if (m_wsServer) {
-        m_wsServer->broadcast(update.toStyledString());
+    // Players standing in the same cell see the same region; serialize it once for all of them
+    std::map<ViewKey, ViewGroup> groups;
+    for (uint64_t clientId : m_wsServer->getRoomClientIds(m_room, WebSocketServer::Protocol::Json)) {
+        InterestGrid::Region view = viewOf(m_entities, clientId);
+        ViewGroup& group = groups[ViewKey(view.minX, view.minY, 0, 0)];
+        group.view = view;
+        group.clients.push_back(clientId);
     }
+    
+    for (const auto& pair : groups) {
+        const ViewGroup& group = pair.second;
+        
+        // Create state update message
+        Json::Value update;
+        update["type"] = "state_update";
+        update["serverTime"] = static_cast<Json::UInt64>(m_serverTime.load());
+        update["tick"] = static_cast<Json::UInt64>(m_tickCount);
+        update["state"] = serializeState(group.view);
+        
+        // Only the newest state is worth delivering to a client that fell behind
+        auto frame = WebSocketServer::makeBuffer(update.toStyledString(), false, WebSocketServer::Delivery::LatestOnly);
+        for (uint64_t clientId : group.clients) {
+            m_wsServer->send(clientId, frame);
+        }
+    }
+    
+    broadcastStateDeltas();
 }
 
-void GameStateManager::removePlayer(uint64_t playerId) {
+void GameStateManager::broadcastStateDeltas() {
+    std::vector<uint64_t> clients = m_wsServer->getRoomClientIds(m_room, WebSocketServer::Protocol::Binary);
+    if (clients.empty()) {
+        return;
+    }
+    
+    // Group clients by acknowledged tick so each distinct delta is encoded once
+    std::unordered_map<uint64_t, std::vector<uint64_t>> clientsByBaseline;
+    {
+        std::lock_guard<std::mutex> lock(m_sequenceMutex);
+        for (uint64_t clientId : clients) {
+            auto it = m_playerAckedTicks.find(clientId);
+            clientsByBaseline[it != m_playerAckedTicks.end() ? it->second : 0].push_back(clientId);
+        }
+    }
+    
+    std::vector<size_t> visible;
+    for (const auto& pair : clientsByBaseline) {
+        // A baseline that aged out of the snapshot ring falls back to a full state. The
+        // delta is against what the client was sent for that tick, which a rewind may
+        // since have corrected; the correction then goes out with this delta.
+        const GameStateSnapshot* baseline = getSnapshot(pair.first);
+        const EntityStore* baseState = baseline ? &baseline->sentState : nullptr;
+        
+        // What the client had at its baseline depends on where its player stood then
+        std::map<ViewKey, ViewGroup> groups;
+        for (uint64_t clientId : pair.second) {
+            InterestGrid::Region view = viewOf(m_entities, clientId);
+            InterestGrid::Region baseView = baseState ? viewOf(*baseState, clientId) : InterestGrid::Region::everything();
+            ViewGroup& group = groups[ViewKey(view.minX, view.minY, baseView.minX, baseView.minY)];
+            group.view = view;
+            group.baseView = baseView;
+            group.clients.push_back(clientId);
+        }
+        
+        for (const auto& entry : groups) {
+            const ViewGroup& group = entry.second;
+            collectVisible(group.view, visible);
+            
+            // Deltas are against the client's acked tick, so a newer one can replace a queued one
+            auto frame = WebSocketServer::makeBuffer(
+                StateCodec::encodeStateDelta(baseState, group.baseView, m_entities, group.view, visible,
+                                             m_tickCount, m_serverTime, pair.first),
+                true, WebSocketServer::Delivery::LatestOnly);
+            for (uint64_t clientId : group.clients) {
+                m_wsServer->send(clientId, frame);
+            }
+        }
+    }
+}
+
+void GameStateManager::acknowledgeState(uint64_t playerId, uint64_t tick) {
     std::lock_guard<std::mutex> lock(m_sequenceMutex);
-    m_playerSequenceNumbers.erase(playerId);
+    uint64_t& acked = m_playerAckedTicks[playerId];
+    if (tick > acked) {
+        acked = tick;
+    }
+}
+
+void GameStateManager::resumePlayer(uint64_t playerId, uint64_t tick) {
+    {
+        // The client's own baseline, even if older than its last ack; a tick no longer
+        // in the ring (or 0) falls back to a full state
+        std::lock_guard<std::mutex> lock(m_sequenceMutex);
+        m_playerAckedTicks[playerId] = tick;
+        
+        // The new connection may number its inputs afresh
+        if (m_playerSequenceNumbers.erase(playerId) > 0) {
+            m_sharedSequenceNumbers.reset();
+        }
+    }
+    m_forceBroadcast = true; // Don't leave a resumed client waiting for the heartbeat
+}
+
+Json::Value GameStateManager::serializeState(const InterestGrid::Region& view) const {
+    Json::Value state;
+    Json::Value players(Json::objectValue);
+    Json::Value entities(Json::arrayValue);
+    
+    std::vector<size_t> visible;
+    collectVisible(view, visible);
+    for (size_t i : visible) {
+        if (m_entities.type(i) == EntityType::Player) {
+            Json::Value& player = players[std::to_string(m_entities.owner(i))];
+            player["x"] = m_entities.x(i);
+            player["y"] = m_entities.y(i);
+        } else {
+            Json::Value entity(Json::objectValue);
+            entity["id"] = m_entities.handle(i);
+            entity["type"] = "projectile";
+            entity["ownerId"] = static_cast<Json::UInt64>(m_entities.owner(i));
+            entity["x"] = m_entities.x(i);
+            entity["y"] = m_entities.y(i);
+            entities.append(entity);
+        }
+    }
+    
+    state["players"] = players;
+    state["entities"] = entities;
+    state["worldState"] = Json::Value(Json::objectValue);
+    return state;
+}
+
+InterestGrid::Region GameStateManager::viewOf(const EntityStore& state, uint64_t playerId) const {
+    EntityStore::Handle handle = state.findPlayer(playerId);
+    if (!state.isValid(handle)) {
+        return InterestGrid::Region::everything(); // Not spawned (spectating)
+    }
+    size_t index = state.indexOf(handle);
+    return m_interest.viewFrom(state.x(index), state.y(index));
+}
+
+void GameStateManager::collectVisible(const InterestGrid::Region& view, std::vector<size_t>& indices) const {
+    indices.clear();
+    if (view.isEverything()) {
+        indices.reserve(m_entities.size());
+        for (size_t i = 0; i < m_entities.size(); ++i) {
+            indices.push_back(i);
+        }
+        return;
+    }
+    m_interest.forEachIn(view, [&](EntityStore::Handle handle) {
+        indices.push_back(m_entities.indexOf(handle));
+    });
+}
+
+EntityStore::Handle GameStateManager::createEntity(EntityType type, uint64_t ownerId, int32_t x, int32_t y, int32_t vx, int32_t vy) {
+    EntityStore::Handle handle = m_entities.create(type, ownerId, x, y, vx, vy);
+    m_interest.update(handle, x, y);
+    return handle;
+}
+
+void GameStateManager::moveEntity(size_t index, int32_t x, int32_t y) {
+    m_entities.setPosition(index, x, y);
+    m_interest.update(m_entities.handle(index), x, y);
+}
+
+void GameStateManager::destroyEntity(EntityStore::Handle handle) {
+    m_interest.remove(handle);
+    m_entities.destroy(handle);
+}
+
+int32_t GameStateManager::findOccupant(int32_t x, int32_t y) const {
+    // The highest dense index wins when players share a cell; indices are part of
+    // the snapshotted state, so re-simulation picks the same target
+    int32_t occupant = -1;
+    m_interest.forEachInCell(x, y, [&](EntityStore::Handle handle) {
+        size_t j = m_entities.indexOf(handle);
+        if (m_entities.type(j) == EntityType::Player && m_entities.x(j) == x && m_entities.y(j) == y &&
+            static_cast<int32_t>(j) > occupant) {
+            occupant = static_cast<int32_t>(j);
+        }
+    });
+    return occupant;
+}
+
+void GameStateManager::spawnPlayer(uint64_t playerId) {
+    GameAction action;
+    action.playerId = playerId;
+    action.actionId = 0;
+    action.timestamp = m_serverTime;
+    action.actionType = ActionType::Spawn;
+    action.clientSequenceNumber = 0;
     
-    // Remove from game state
-    m_currentState["players"].removeMember(std::to_string(playerId));
+    enqueueControlAction(std::move(action));
+}
+
+void GameStateManager::removePlayer(uint64_t playerId) {
+    {
+        std::lock_guard<std::mutex> lock(m_sequenceMutex);
+        if (m_playerSequenceNumbers.erase(playerId) > 0) {
+            m_sharedSequenceNumbers.reset();
+        }
+        m_playerAckedTicks.erase(playerId);
+    }
+    
+    // The entity store is owned by the tick thread; despawn through the action queue
+    GameAction action;
+    action.playerId = playerId;
+    action.actionId = 0;
+    action.timestamp = m_serverTime;
+    action.actionType = ActionType::Despawn;
+    action.clientSequenceNumber = 0;
+    
+    enqueueControlAction(std::move(action));
 }
 
 uint64_t GameStateManager::getServerTime() const {
     return m_serverTime;
 }
 
-void GameStateManager::processActions() {
-    std::lock_guard<std::mutex> lock(m_actionQueueMutex);
+void GameStateManager::processActions(bool drainQueue) {
+    // Drain only what was queued when the tick started so a flood of producers
+    // cannot keep the tick thread in this loop. A replayed tick already has its actions.
+    size_t budget = drainQueue ? m_actionQueue.sizeApprox() : 0;
+    uint64_t oldestTick = m_tickCount > m_rewindTickLimit ? m_tickCount - m_rewindTickLimit : 1;
     
-    while (!m_actionQueue.empty()) {
-        GameAction action = m_actionQueue.front();
-        m_actionQueue.pop();
-        
-        applyAction(action);
+    // Control actions that overflowed the ring were queued before anything now in it
+    if (drainQueue && m_hasControlActions.load(std::memory_order_acquire)) {
+        {
+            std::lock_guard<std::mutex> lock(m_controlMutex);
+            m_drainedControlActions.swap(m_controlActions);
+            m_hasControlActions.store(false, std::memory_order_relaxed);
+        }
+        for (GameAction& control : m_drainedControlActions) {
+            acceptAction(std::move(control), oldestTick);
+        }
+        m_drainedControlActions.clear();
+    }
+    
+    GameAction action;
+    while (budget-- > 0 && m_actionQueue.tryPop(action)) {
+        acceptAction(std::move(action), oldestTick);
+    }
+    
+    if (!m_lateActions.empty()) {
+        resimulateLateActions();
+    }
+    
+    for (GameAction& current : m_currentActions) {
+        applyAction(current, false);
+        m_tickActions.push_back(std::move(current));
+    }
+    m_currentActions.clear();
+    
+    uint64_t dropped = m_droppedActions.load(std::memory_order_relaxed);
+    if (dropped != m_reportedDroppedActions) {
+        if (m_metrics) {
+            m_metrics->droppedActions.add(dropped - m_reportedDroppedActions);
+        }
+        LOG_WARN("GameState", "Action queue full: dropped {} actions ({} total)", dropped - m_reportedDroppedActions, dropped);
+        m_reportedDroppedActions = dropped;
     }
 }
 
-void GameStateManager::applyAction(const GameAction& action) {
-    const Player* player = m_playerManager->getPlayer(action.playerId);
-    if (!player) {
+void GameStateManager::acceptAction(GameAction&& action, uint64_t oldestTick) {
+    // Despawn is queued internally on disconnect, after the player may already be gone
+    if (action.actionType != ActionType::Despawn && !m_playerManager->playerExists(action.playerId)) {
         return;
     }
     
-    // Spawn Action - New 8x8 Grid Logic
-    if (action.actionType == "spawn") {
-        std::string playerKey = std::to_string(action.playerId);
+    // An action made while viewing tick C belongs to tick C + 1; anything the
+    // client saw before the previous tick is late and gets rewound
+    bool rewindable = action.actionType == ActionType::Move || action.actionType == ActionType::Shoot;
+    bool late = rewindable && action.clientTick != 0 && action.clientTick + 1 < m_tickCount;
+    if (late) {
+        action.clientTick = std::max(action.clientTick + 1, oldestTick);
+    }
+    if (m_actionLog) {
+        recordAction(action, late);
+    }
+    (late ? m_lateActions : m_currentActions).push_back(std::move(action));
+}
+
+void GameStateManager::recordAction(const GameAction& action, bool late) {
+    ActionLog::Record record{};
+    record.kind = ActionLog::RecordKind::Action;
+    record.actionType = static_cast<uint8_t>(action.actionType);
+    record.late = late;
+    record.tick = m_tickCount;
+    record.playerId = action.playerId;
+    record.actionId = action.actionId;
+    record.timestamp = action.timestamp;
+    record.clientSequenceNumber = action.clientSequenceNumber;
+    record.targetTick = action.clientTick;
+    record.dx = action.dx;
+    record.dy = action.dy;
+    m_actionLog->append(record);
+}
+
+void GameStateManager::resimulateLateActions() {
+    auto start = std::chrono::steady_clock::now();
+    
+    std::stable_sort(m_lateActions.begin(), m_lateActions.end(),
+        [](const GameAction& a, const GameAction& b) { return a.clientTick < b.clientTick; });
+    
+    // Rewind to the last tick that ran before the earliest late action. Ticks can be
+    // missing from the ring when the scheduler skipped them.
+    GameStateSnapshot* base = nullptr;
+    for (uint64_t t = m_lateActions.front().clientTick - 1; t > 0 && t + SNAPSHOT_CAPACITY > m_tickCount; --t) {
+        if ((base = getSnapshot(t)) != nullptr) {
+            break;
+        }
+    }
+    if (!base) {
+        // No history to rewind to: apply them now, as if on time
+        for (GameAction& late : m_lateActions) {
+            m_currentActions.push_back(std::move(late));
+        }
+        m_lateActions.clear();
+        return;
+    }
+    
+    m_entities = base->state;
+    m_interest.rebuild(m_entities);
+    
+    // Replay every tick that ran since, with the late actions merged into the journal
+    size_t next = 0;
+    uint64_t resimulated = 0;
+    std::vector<HitEvent> hits;
+    for (uint64_t t = base->snapshotId + 1; t < m_tickCount; ++t) {
+        GameStateSnapshot* snapshot = getSnapshot(t);
+        if (!snapshot) {
+            continue;
+        }
         
-        // Random Position 0-7
-        static std::random_device rd;
-        static std::mt19937 gen(rd());
-        static std::uniform_int_distribution<> dis(0, 7);
+        while (next < m_lateActions.size() && m_lateActions[next].clientTick <= t) {
+            snapshot->actions.push_back(std::move(m_lateActions[next++]));
+        }
+        for (GameAction& replayed : snapshot->actions) {
+            applyAction(replayed, true);
+        }
         
-        // Find a free spot (simple approach, try 10 times)
-        int x = dis(gen);
-        int y = dis(gen);
+        hits.clear();
+        simulateTick(t, hits);
+        for (const HitEvent& hit : hits) {
+            // Hits that only exist in the corrected timeline are announced now
+            if (std::find(snapshot->hits.begin(), snapshot->hits.end(), hit) == snapshot->hits.end()) {
+                announceHit(hit, t);
+            }
+        }
+        snapshot->hits.swap(hits);
+        snapshot->state = m_entities;
+        resimulated++;
+    }
+    
+    // Targets past the last recorded tick fall through to the present
+    for (; next < m_lateActions.size(); ++next) {
+        m_currentActions.push_back(std::move(m_lateActions[next]));
+    }
+    m_lateActions.clear();
+    m_stateDirty = true;
+    
+    m_rewinds.fetch_add(1, std::memory_order_relaxed);
+    m_resimulatedTicks.fetch_add(resimulated, std::memory_order_relaxed);
+    if (m_metrics) {
+        m_metrics->rewinds.add();
+        m_metrics->resimulatedTicks.add(resimulated);
+    }
+    
+    // Keep the next rewind within budget at the cost measured for this one
+    int64_t elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    if (resimulated > 0) {
+        uint64_t perTickUs = std::max<int64_t>(1, elapsedUs / static_cast<int64_t>(resimulated));
+        m_rewindTickLimit = std::max(MIN_REWIND_TICKS, std::min(m_maxRewindTicks, RESIMULATION_BUDGET_US / perTickUs));
+    }
+}
+
+void GameStateManager::applyAction(GameAction& action, bool replaying) {
+    // Players that left are filtered when the queue is drained (processActions); a
+    // re-simulated action was valid when it first ran, even if the player has left since
+    if (action.actionType == ActionType::Despawn) {
+        destroyEntity(m_entities.findPlayer(action.playerId));
+        m_stateDirty = true;
+        return;
+    }
+    
+    // Spawn Action - Grid Logic
+    if (action.actionType == ActionType::Spawn) {
+        if (!action.resolved) {
+            // Random Position 0 to worldSize-1. Reduced by hand rather than with a
+            // distribution, whose output differs between standard libraries.
+            action.spawnX = static_cast<int32_t>(m_rng() % static_cast<uint64_t>(m_worldSize));
+            action.spawnY = static_cast<int32_t>(m_rng() % static_cast<uint64_t>(m_worldSize));
+            m_rngDraws += 2;
+            action.resolved = true;
+        }
+        int x = action.spawnX;
+        int y = action.spawnY;
         
-        // Save to state
-        m_currentState["players"][playerKey] = Json::Value(Json::objectValue);
-        m_currentState["players"][playerKey]["x"] = x;
-        m_currentState["players"][playerKey]["y"] = y;
+        // Respawning moves the existing entity instead of creating a second one
+        EntityStore::Handle handle = m_entities.findPlayer(action.playerId);
+        if (m_entities.isValid(handle)) {
+            moveEntity(m_entities.indexOf(handle), x, y);
+        } else {
+            createEntity(EntityType::Player, action.playerId, x, y);
+        }
         m_stateDirty = true;
         
-        std::cout << "Player " << action.playerId << " spawned at (" << x << ", " << y << ")" << std::endl;
+        if (!replaying) {
+            LOG_INFO("GameState", "Player {} spawned at ({}, {})", action.playerId, x, y);
+        }
         return;
     }
-
-    // Move Action - New 8x8 Grid Logic
-    if (action.actionType == "move") {
-        std::string playerKey = std::to_string(action.playerId);
-        
+    
+    // Move Action - Grid Logic
+    if (action.actionType == ActionType::Move) {
         // Only allow move if player exists in state (spawned)
-        if (m_currentState["players"].isMember(playerKey)) {
-            int currentX = m_currentState["players"][playerKey]["x"].asInt();
-            int currentY = m_currentState["players"][playerKey]["y"].asInt();
+        EntityStore::Handle handle = m_entities.findPlayer(action.playerId);
+        if (m_entities.isValid(handle)) {
+            size_t index = m_entities.indexOf(handle);
             
-            int dx = action.data.get("dx", 0).asInt();
-            int dy = action.data.get("dy", 0).asInt();
+            int dx = action.dx;
+            int dy = action.dy;
             
             // Calculate new pos
-            int newX = currentX + dx;
-            int newY = currentY + dy;
+            int newX = m_entities.x(index) + dx;
+            int newY = m_entities.y(index) + dy;
             
-            // Clamp to grid 0-7
-            if (newX >= 0 && newX <= 7 && newY >= 0 && newY <= 7) {
-                m_currentState["players"][playerKey]["x"] = newX;
-                m_currentState["players"][playerKey]["y"] = newY;
+            // Clamp to grid
+            if (newX >= 0 && newX < m_worldSize && newY >= 0 && newY < m_worldSize) {
+                moveEntity(index, newX, newY);
                 m_stateDirty = true;
             }
         }
@@ -153,88 +660,138 @@ void GameStateManager::applyAction(const GameAction& action) {
     }
     
     // Shoot Action
-    if (action.actionType == "shoot") {
-        // Create projectile entity (simplified for now)
-        Json::Value projectile(Json::objectValue);
-        projectile["id"] = static_cast<Json::UInt64>(m_tickCount * 1000 + action.actionId);
-        projectile["type"] = "projectile";
-        projectile["ownerId"] = static_cast<Json::UInt64>(action.playerId);
-        // ... projectile logic could be added here
+    if (action.actionType == ActionType::Shoot) {
+        EntityStore::Handle handle = m_entities.findPlayer(action.playerId);
+        if (!m_entities.isValid(handle)) {
+            return;
+        }
+        
+        int dx = std::max(-1, std::min(1, action.dx));
+        int dy = std::max(-1, std::min(1, action.dy));
+        if (dx == 0 && dy == 0) {
+            return;
+        }
         
-        // For now, just log it
-        // std::cout << "Player " << action.playerId << " shot!" << std::endl;
+        // Projectile starts on the shooter's cell and travels in a straight line
+        size_t index = m_entities.indexOf(handle);
+        createEntity(EntityType::Projectile, action.playerId, m_entities.x(index), m_entities.y(index), dx, dy);
+        m_stateDirty = true;
     }
 }
 
 bool GameStateManager::validateAction(const GameAction& action) {
-    const Player* player = m_playerManager->getPlayer(action.playerId);
-    if (!player) {
+    if (!m_playerManager->playerExists(action.playerId)) {
         return false;
     }
     
-    // Check timestamp
-    // NOTE: Disabled strict timestamp check for demo because client uses Date.now() (wall clock)
-    // and server uses steady_clock (uptime), causing mismatch.
-    // In production, sync clocks or use server-authoritative timestamps.
-    /*
-    int64_t timeDiff = static_cast<int64_t>(m_serverTime) - static_cast<int64_t>(action.timestamp);
-    if (timeDiff > 5000 || timeDiff < -100) { 
-        return false;
-    }
-    */
+    // Lateness is judged by clientTick on the tick thread: late move/shoot actions
+    // are rewound to the tick the client acted on (see processActions). Wall-clock
+    // timestamps are not comparable between client and server.
     
-    if (action.actionType.empty()) {
+    if (action.actionType == ActionType::Unknown || action.actionType == ActionType::Despawn) {
         return false;
     }
     
     return true;
 }
 
-void GameStateManager::simulateTick() {
-    // Game physics simulation (projectiles, etc.) can go here
+void GameStateManager::simulateTick(uint64_t tick, std::vector<HitEvent>& hits) {
+    std::vector<EntityStore::Handle> expired;
+    
+    // Linear pass over packed components
+    for (size_t i = 0; i < m_entities.size(); ++i) {
+        if (m_entities.type(i) != EntityType::Projectile) {
+            continue;
+        }
+        
+        uint32_t age = m_entities.age(i) + 1;
+        m_entities.setAge(i, age);
+        if (age % m_projectileStepTicks != 0) {
+            continue;
+        }
+        
+        int32_t x = m_entities.x(i) + m_entities.vx(i);
+        int32_t y = m_entities.y(i) + m_entities.vy(i);
+        moveEntity(i, x, y);
+        m_stateDirty = true;
+        
+        if (x < 0 || x >= m_worldSize || y < 0 || y >= m_worldSize) {
+            expired.push_back(m_entities.handle(i));
+            continue;
+        }
+        
+        // Hits are checked against positions at this tick, which for a rewound shot
+        // are the positions the shooter saw
+        int32_t target = findOccupant(x, y);
+        if (target < 0 || m_entities.owner(target) == m_entities.owner(i)) {
+            continue;
+        }
+        
+        uint64_t targetId = m_entities.owner(target);
+        hits.push_back(HitEvent{m_entities.owner(i), targetId});
+        expired.push_back(m_entities.handle(i));
+        
+        // Respawn the target on a cell derived from (tick, player) so replays agree
+        uint64_t mix = (tick * 0x9E3779B97F4A7C15ull) ^ (targetId * 0xBF58476D1CE4E5B9ull);
+        mix ^= mix >> 31;
+        uint64_t cell = mix % (static_cast<uint64_t>(m_worldSize) * m_worldSize);
+        moveEntity(target, static_cast<int32_t>(cell % m_worldSize), static_cast<int32_t>(cell / m_worldSize));
+    }
+    
+    // Destroy after the pass; swap-remove would otherwise reorder entities mid-iteration
+    for (EntityStore::Handle handle : expired) {
+        destroyEntity(handle);
+    }
+}
+
+void GameStateManager::announceHit(const HitEvent& hit, uint64_t tick) {
+    if (!m_wsServer) {
+        return;
+    }
+    
+    Json::Value message;
+    message["type"] = "player_hit";
+    message["shooterId"] = static_cast<Json::UInt64>(hit.shooterId);
+    message["targetId"] = static_cast<Json::UInt64>(hit.targetId);
+    message["tick"] = static_cast<Json::UInt64>(tick);
+    m_wsServer->broadcastToRoom(m_room, message.toStyledString());
 }
 
 void GameStateManager::createSnapshot() {
-    std::lock_guard<std::mutex> lock(m_snapshotsMutex);
-    
-    GameStateSnapshot snapshot;
+    GameStateSnapshot& snapshot = m_snapshots[m_tickCount % SNAPSHOT_CAPACITY];
     snapshot.snapshotId = m_tickCount;
     snapshot.timestamp = m_serverTime;
-    snapshot.state = m_currentState;
-    snapshot.playerSequenceNumbers = m_playerSequenceNumbers;
+    snapshot.state = m_entities; // Chunk pointer copies
+    snapshot.sentState = m_entities;
+    snapshot.actions.swap(m_tickActions);
+    snapshot.hits.swap(m_tickHits);
+    m_tickActions.clear(); // Keeps the recycled slot's capacity
+    m_tickHits.clear();
     
-    m_snapshots.push_back(snapshot);
-    
-    if (m_snapshots.size() > MAX_SNAPSHOTS) {
-        m_snapshots.erase(m_snapshots.begin());
+    std::lock_guard<std::mutex> lock(m_sequenceMutex);
+    if (!m_sharedSequenceNumbers) {
+        m_sharedSequenceNumbers = std::make_shared<const SequenceNumberMap>(m_playerSequenceNumbers);
     }
+    snapshot.playerSequenceNumbers = m_sharedSequenceNumbers;
 }
 
 void GameStateManager::rollbackToSnapshot(uint64_t snapshotId) {
-    std::lock_guard<std::mutex> lock(m_snapshotsMutex);
-    auto it = std::find_if(m_snapshots.begin(), m_snapshots.end(),
-        [snapshotId](const GameStateSnapshot& s) { return s.snapshotId == snapshotId; });
-    if (it != m_snapshots.end()) {
-        m_currentState = it->state;
-        m_playerSequenceNumbers = it->playerSequenceNumbers;
+    GameStateSnapshot* snapshot = getSnapshot(snapshotId);
+    if (!snapshot) {
+        return;
     }
+    
+    m_entities = snapshot->state;
+    m_interest.rebuild(m_entities);
+    std::lock_guard<std::mutex> lock(m_sequenceMutex);
+    m_playerSequenceNumbers = *snapshot->playerSequenceNumbers;
+    m_sharedSequenceNumbers = snapshot->playerSequenceNumbers;
 }
 
 GameStateSnapshot* GameStateManager::getSnapshot(uint64_t snapshotId) {
-    std::lock_guard<std::mutex> lock(m_snapshotsMutex);
-    auto it = std::find_if(m_snapshots.begin(), m_snapshots.end(),
-        [snapshotId](const GameStateSnapshot& s) { return s.snapshotId == snapshotId; });
-    if (it != m_snapshots.end()) {
-        return &(*it);
-    }
-    return nullptr;
-}
-
-void GameStateManager::cleanupOldSnapshots() {
-    std::lock_guard<std::mutex> lock(m_snapshotsMutex);
-    uint64_t cutoffTime = m_serverTime - 5000;
-    m_snapshots.erase(
-        std::remove_if(m_snapshots.begin(), m_snapshots.end(),
-            [cutoffTime](const GameStateSnapshot& s) { return s.timestamp < cutoffTime; }),
-        m_snapshots.end());
+    GameStateSnapshot& snapshot = m_snapshots[snapshotId % SNAPSHOT_CAPACITY];
+    if (snapshotId == 0 || snapshot.snapshotId != snapshotId) {
+        return nullptr;
+    }
+    return &snapshot;
 }
@@ -1,77 +1,218 @@
 #pragma once
 
 #include "PlayerManager.h"
+#include "EntityStore.h"
+#include "InterestGrid.h"
+#include "Metrics.h"
+#include "MpscRing.h"
+#include "MessageParser.h"
+#include "ActionLog.h"
 #include <json/json.h>
 #include <unordered_map>
 #include <string>
 #include <vector>
 #include <mutex>
-#include <queue>
 #include <cstdint>
+#include <atomic>
+#include <memory>
+#include <random>
 
 class WebSocketServer;
 
+using MessageParser::ActionType;
+
 struct GameAction {
     uint64_t playerId;
     uint64_t actionId;
     uint64_t timestamp;
-    std::string actionType;
-    Json::Value data; // Action-specific data
+    ActionType actionType;
+    int32_t dx = 0; // Move/shoot direction
+    int32_t dy = 0;
     uint64_t clientSequenceNumber;
+    uint64_t clientTick = 0; // Tick the client acted on; late move/shoot are rewound to it. 0 = apply on arrival
+    
+    // Outcome of random choices, recorded on first apply so re-simulation replays it exactly
+    bool resolved = false;
+    int32_t spawnX = 0;
+    int32_t spawnY = 0;
+};
+
+struct HitEvent {
+    uint64_t shooterId;
+    uint64_t targetId;
+    
+    bool operator==(const HitEvent& other) const {
+        return shooterId == other.shooterId && targetId == other.targetId;
+    }
 };
 
+using SequenceNumberMap = std::unordered_map<uint64_t, uint64_t>;
+
 struct GameStateSnapshot {
-    uint64_t snapshotId;
-    uint64_t timestamp;
-    Json::Value state; // Game state data
-    std::unordered_map<uint64_t, uint64_t> playerSequenceNumbers;
+    uint64_t snapshotId = 0; // Tick the snapshot was taken on; 0 = empty slot
+    uint64_t timestamp = 0;
+    EntityStore state; // Shares unchanged chunks with neighbouring snapshots
+    EntityStore sentState; // As broadcast on this tick, the delta baseline; re-simulation only corrects state
+    std::shared_ptr<const SequenceNumberMap> playerSequenceNumbers; // Shared until the map changes
+    std::vector<GameAction> actions; // Applied during this tick, replayed on re-simulation
+    std::vector<HitEvent> hits;      // Already announced for this tick
 };
 
 class GameStateManager {
 public:
-    GameStateManager(PlayerManager* playerManager, WebSocketServer* wsServer);
+    static constexpr int DEFAULT_TICK_RATE = 120;
+    static constexpr int32_t DEFAULT_WORLD_SIZE = 8;
+    
+    // roomId scopes broadcasts to one match; "" is the lobby world for players not in a match.
+    // tickRate is how often the WorldScheduler ticks this world, in ticks per second.
+    // worldSize is the side of the square world, in cells.
+    GameStateManager(PlayerManager* playerManager, WebSocketServer* wsServer, const std::string& roomId = "",
+                     int tickRate = DEFAULT_TICK_RATE, int32_t worldSize = DEFAULT_WORLD_SIZE);
     ~GameStateManager();
     
-    void tick(); // Called every game tick
-    void handlePlayerAction(uint64_t playerId, const Json::Value& actionData); // JSON variant
+    void tick(uint64_t tickNumber); // Called every game tick; tick n is due n periods after the scheduler epoch
+    bool handlePlayerAction(uint64_t playerId, const MessageParser::GameActionPayload& payload); // False if rejected or dropped
+    // Queues a client batch in one pass; actions with a sequence number at or below the
+    // player's last queued one are resends and skipped. Returns how many were queued
+    size_t handlePlayerActions(uint64_t playerId, const MessageParser::GameActionPayload* payloads, size_t count);
     void broadcastStateUpdates();
+    void acknowledgeState(uint64_t playerId, uint64_t tick); // Binary clients ack the last applied tick
+    void resumePlayer(uint64_t playerId, uint64_t tick); // Reconnected; tick is the client's last applied state
     
+    void spawnPlayer(uint64_t playerId);
     void removePlayer(uint64_t playerId);
     
+    void setMetrics(Metrics::TickMetrics* metrics) { m_metrics = metrics; } // Before the world is scheduled
+    
+    // Deterministic recording: the RNG seed and every accepted action go to log, with
+    // a state hash per tick. Set before the world is scheduled; the seed before its first tick
+    void setActionLog(std::shared_ptr<ActionLog::Writer> log) { m_actionLog = std::move(log); }
+    void setSeed(uint64_t seed);
+    uint64_t getSeed() const { return m_seed; }
+    uint64_t getRngDraws() const { return m_rngDraws; }
+    
+    // Headless replay of a recording: runs tickNumber with the recorded action records
+    // in place of the queue and returns the resulting state hash. PlayerManager and
+    // WebSocketServer may both be null on a replayed world.
+    uint64_t replayTick(uint64_t tickNumber, uint64_t serverTime, const ActionLog::Record* actions, size_t count);
+    size_t getEntityCount() const { return m_entities.size(); }
+    
+    const std::string& getRoomId() const { return m_roomId; }
+    int getTickRate() const { return m_tickRate; }
+    int32_t getWorldSize() const { return m_worldSize; }
+    
     uint64_t getServerTime() const;
     
-    // Rollback/Reconciliation
+    // Lag compensation
+    uint64_t getRewindCount() const { return m_rewinds.load(std::memory_order_relaxed); }
+    uint64_t getResimulatedTickCount() const { return m_resimulatedTicks.load(std::memory_order_relaxed); }
+    
+    // Action ingress backpressure
+    size_t getActionQueueDepth() const { return m_actionQueue.sizeApprox(); }
+    uint64_t getDroppedActionCount() const { return m_droppedActions.load(std::memory_order_relaxed); }
+    
+    // Rollback/Reconciliation (tick thread only). Snapshot IDs are tick numbers; a
+    // returned snapshot stays valid until its ring slot is reused.
     void rollbackToSnapshot(uint64_t snapshotId);
     GameStateSnapshot* getSnapshot(uint64_t snapshotId);
     void createSnapshot();
     
+    // JSON view of the entity store inside view, built at the serialization edge
+    Json::Value serializeState(const InterestGrid::Region& view = InterestGrid::Region::everything()) const;
+
 private:
     PlayerManager* m_playerManager;
     WebSocketServer* m_wsServer;
+    std::string m_roomId;
+    uint32_t m_room; // Interned m_roomId, WebSocketServer::RoomHandle
+    int m_tickRate;
+    int32_t m_worldSize;
+    Metrics::TickMetrics* m_metrics; // Shared by all worlds; may be null
+    
+    // Spawn positions are the only random choice; a per-world seeded RNG keeps them replayable
+    std::mt19937_64 m_rng;
+    uint64_t m_seed;
+    uint64_t m_rngDraws;
+    std::shared_ptr<ActionLog::Writer> m_actionLog; // Null unless recording
     
     // Game state
-    Json::Value m_currentState;
-    uint64_t m_serverTime;
+    EntityStore m_entities;
+    
+    // Interest management: entity positions bucketed by cell, updated on every
+    // create/move/destroy so each client's update only carries what is near its
+    // player. Clients with no player in the world see everything.
+    InterestGrid m_interest;
+    std::atomic<uint64_t> m_serverTime;
     uint64_t m_tickCount;
     bool m_stateDirty; // Only broadcast if something changed
+    std::atomic<bool> m_forceBroadcast; // Set off the tick thread, e.g. when a player resumes
     
-    // Action queue
-    std::queue<GameAction> m_actionQueue;
-    std::mutex m_actionQueueMutex;
+    // Action queue: network threads produce, the tick thread drains without taking a lock
+    MpscRing<GameAction> m_actionQueue;
+    std::atomic<uint64_t> m_droppedActions;
+    uint64_t m_reportedDroppedActions; // Tick thread only
+    static const size_t ACTION_QUEUE_CAPACITY = 4096;
     
-    // Snapshot system for rollback
+    // Spawn/despawn that found the ring full past a short wait; drained by the tick
+    // thread ahead of the ring, so a producer never waits on a world nobody ticks
+    std::vector<GameAction> m_controlActions;
+    std::vector<GameAction> m_drainedControlActions; // Tick thread scratch
+    std::atomic<bool> m_hasControlActions;
+    std::mutex m_controlMutex;
+    static constexpr int CONTROL_PUSH_ATTEMPTS = 64;
+    
+    // Snapshot ring for rollback and delta baselines: one slot per tick, indexed by
+    // tick % SNAPSHOT_CAPACITY. Owned by the tick thread.
     std::vector<GameStateSnapshot> m_snapshots;
-    std::mutex m_snapshotsMutex;
-    static const size_t MAX_SNAPSHOTS = 100;
+    static const size_t SNAPSHOT_CAPACITY = 256; // ~2s of history at 120 ticks/s
+    
+    // Durations below are in real time and converted to ticks at m_tickRate
+    uint64_t m_heartbeatTicks; // Broadcast at least this often even when nothing changed
+    uint32_t m_projectileStepTicks;
+    static constexpr int HEARTBEAT_MS = 500;
+    static constexpr int PROJECTILE_CELLS_PER_SECOND = 20;
+    
+    // Lag compensation: late move/shoot actions are inserted at the tick the client
+    // acted on and the world is re-simulated forward from there. The rewind depth
+    // adapts so re-simulation stays within RESIMULATION_BUDGET_US per tick.
+    std::vector<GameAction> m_tickActions; // Journal for the tick in progress
+    std::vector<HitEvent> m_tickHits;
+    std::vector<GameAction> m_currentActions; // Scratch, drained each tick
+    std::vector<GameAction> m_lateActions;
+    uint64_t m_rewindTickLimit;
+    uint64_t m_maxRewindTicks;
+    std::atomic<uint64_t> m_rewinds;
+    std::atomic<uint64_t> m_resimulatedTicks;
+    static constexpr int MAX_REWIND_MS = 300;
+    static constexpr uint64_t MIN_REWIND_TICKS = 4;
+    static constexpr int64_t RESIMULATION_BUDGET_US = 2000;
     
-    // Player sequence numbers for reconciliation
-    std::unordered_map<uint64_t, uint64_t> m_playerSequenceNumbers;
+    // Last queued client sequence number per player, for dropping resent inputs
+    SequenceNumberMap m_playerSequenceNumbers;
+    std::shared_ptr<const SequenceNumberMap> m_sharedSequenceNumbers; // Snapshot copy; reset on change
+    std::unordered_map<uint64_t, uint64_t> m_playerAckedTicks; // Delta baseline per binary client
     std::mutex m_sequenceMutex;
     
-    void processActions();
-    void applyAction(const GameAction& action);
+    void runTick(bool drainQueue);
+    void processActions(bool drainQueue);
+    void acceptAction(GameAction&& action, uint64_t oldestTick); // Sorts a drained action into current or late
+    void recordAction(const GameAction& action, bool late);
+    bool enqueueAction(GameAction&& action);
+    void enqueueControlAction(GameAction&& action);
+    void applyAction(GameAction& action, bool replaying);
     bool validateAction(const GameAction& action);
-    void simulateTick();
-    void cleanupOldSnapshots();
+    void resimulateLateActions();
+    void simulateTick(uint64_t tick, std::vector<HitEvent>& hits);
+    void announceHit(const HitEvent& hit, uint64_t tick);
+    void broadcastStateDeltas();
+    
+    // Entity writes go through these to keep m_interest in step with m_entities
+    EntityStore::Handle createEntity(EntityType type, uint64_t ownerId, int32_t x, int32_t y, int32_t vx = 0, int32_t vy = 0);
+    void moveEntity(size_t index, int32_t x, int32_t y);
+    void destroyEntity(EntityStore::Handle handle);
+    
+    InterestGrid::Region viewOf(const EntityStore& state, uint64_t playerId) const;
+    void collectVisible(const InterestGrid::Region& view, std::vector<size_t>& indices) const;
+    int32_t findOccupant(int32_t x, int32_t y) const; // Dense index of the player on (x, y), or -1
 };
 
@@ -0,0 +1,77 @@
+#include "InterestGrid.h"
+#include <algorithm>
+
+InterestGrid::InterestGrid(int32_t cellSize, int32_t viewRadius)
+    : m_cellSize(std::max(1, cellSize)), m_viewRadius(std::max(0, viewRadius)) {}
+
+void InterestGrid::update(EntityStore::Handle handle, int32_t x, int32_t y) {
+    uint64_t key = cellKey(x, y);
+    if (handle >= m_entityCells.size()) {
+        m_entityCells.resize(handle + 1, 0);
+        m_entitySlots.resize(handle + 1, NO_SLOT);
+    } else if (m_entitySlots[handle] != NO_SLOT && m_entityCells[handle] == key) {
+        return; // Moved within its cell
+    }
+
+    remove(handle);
+    std::vector<EntityStore::Handle>& cell = m_cells[key];
+    m_entityCells[handle] = key;
+    m_entitySlots[handle] = static_cast<uint32_t>(cell.size());
+    cell.push_back(handle);
+}
+
+void InterestGrid::remove(EntityStore::Handle handle) {
+    if (handle >= m_entitySlots.size() || m_entitySlots[handle] == NO_SLOT) {
+        return;
+    }
+
+    auto it = m_cells.find(m_entityCells[handle]);
+    std::vector<EntityStore::Handle>& cell = it->second;
+    uint32_t slot = m_entitySlots[handle];
+
+    // Swap-remove; the moved handle takes over the slot
+    EntityStore::Handle last = cell.back();
+    cell[slot] = last;
+    m_entitySlots[last] = slot;
+    cell.pop_back();
+    if (cell.empty()) {
+        m_cells.erase(it);
+    }
+
+    m_entitySlots[handle] = NO_SLOT;
+}
+
+void InterestGrid::rebuild(const EntityStore& entities) {
+    m_cells.clear();
+    m_entitySlots.assign(m_entitySlots.size(), NO_SLOT);
+    for (size_t i = 0; i < entities.size(); ++i) {
+        update(entities.handle(i), entities.x(i), entities.y(i));
+    }
+}
+
+InterestGrid::Region InterestGrid::viewFrom(int32_t x, int32_t y) const {
+    auto lower = [this](int32_t coordinate) {
+        int64_t bound = (static_cast<int64_t>(cellOf(coordinate)) - m_viewRadius) * m_cellSize;
+        return static_cast<int32_t>(std::max<int64_t>(bound, std::numeric_limits<int32_t>::min() + 1));
+    };
+    auto upper = [this](int32_t coordinate) {
+        int64_t bound = (static_cast<int64_t>(cellOf(coordinate)) + m_viewRadius + 1) * m_cellSize - 1;
+        return static_cast<int32_t>(std::min<int64_t>(bound, std::numeric_limits<int32_t>::max()));
+    };
+
+    Region region;
+    region.minX = lower(x);
+    region.minY = lower(y);
+    region.maxX = upper(x);
+    region.maxY = upper(y);
+    return region;
+}
+
+uint64_t InterestGrid::cellKey(int32_t x, int32_t y) const {
+    return pack(cellOf(x), cellOf(y));
+}
+
+int32_t InterestGrid::cellOf(int32_t coordinate) const {
+    int32_t cell = coordinate / m_cellSize;
+    return (coordinate % m_cellSize < 0) ? cell - 1 : cell;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "EntityStore.h"
+#include <vector>
+#include <unordered_map>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+
+// Spatial hash over world coordinates for interest management. The world is cut
+// into square cells of cellSize units; each cell lists the entity handles inside
+// it. Membership is kept up to date as entities move (only a cell change touches
+// the hash), so finding what is near a point costs the handful of cells around
+// it rather than a pass over every entity.
+//
+// A client's area of interest is the block of cells within viewRadius of the cell
+// its player stands in. Regions are cell aligned, so an entity is inside a region
+// exactly when its cell is.
+class InterestGrid {
+public:
+    static constexpr int32_t DEFAULT_CELL_SIZE = 8;
+    static constexpr int32_t DEFAULT_VIEW_RADIUS = 1; // In cells
+
+    // Inclusive bounds in world units
+    struct Region {
+        int32_t minX = std::numeric_limits<int32_t>::min();
+        int32_t minY = std::numeric_limits<int32_t>::min();
+        int32_t maxX = std::numeric_limits<int32_t>::max();
+        int32_t maxY = std::numeric_limits<int32_t>::max();
+
+        static Region everything() { return Region(); }
+        bool isEverything() const { return minX == std::numeric_limits<int32_t>::min(); }
+        bool contains(int32_t x, int32_t y) const { return x >= minX && x <= maxX && y >= minY && y <= maxY; }
+    };
+
+    explicit InterestGrid(int32_t cellSize = DEFAULT_CELL_SIZE, int32_t viewRadius = DEFAULT_VIEW_RADIUS);
+
+    void update(EntityStore::Handle handle, int32_t x, int32_t y); // Inserts or moves
+    void remove(EntityStore::Handle handle);
+    void rebuild(const EntityStore& entities);
+
+    Region viewFrom(int32_t x, int32_t y) const;
+    uint64_t cellKey(int32_t x, int32_t y) const; // Identifies the view from (x, y)
+
+    // Visits every handle inside region (which must not be everything())
+    template <typename Fn>
+    void forEachIn(const Region& region, Fn&& fn) const {
+        for (int32_t cy = cellOf(region.minY); cy <= cellOf(region.maxY); ++cy) {
+            for (int32_t cx = cellOf(region.minX); cx <= cellOf(region.maxX); ++cx) {
+                auto it = m_cells.find(pack(cx, cy));
+                if (it == m_cells.end()) {
+                    continue;
+                }
+                for (EntityStore::Handle handle : it->second) {
+                    fn(handle);
+                }
+            }
+        }
+    }
+
+    // Visits the handles sharing the cell of (x, y)
+    template <typename Fn>
+    void forEachInCell(int32_t x, int32_t y, Fn&& fn) const {
+        auto it = m_cells.find(cellKey(x, y));
+        if (it != m_cells.end()) {
+            for (EntityStore::Handle handle : it->second) {
+                fn(handle);
+            }
+        }
+    }
+
+private:
+    static constexpr uint32_t NO_SLOT = UINT32_MAX; // Not in the grid
+
+    int32_t m_cellSize;
+    int32_t m_viewRadius;
+    std::unordered_map<uint64_t, std::vector<EntityStore::Handle>> m_cells;
+
+    // Indexed by handle: the entity's cell and its position in that cell's list (NO_SLOT if absent)
+    std::vector<uint64_t> m_entityCells;
+    std::vector<uint32_t> m_entitySlots;
+
+    int32_t cellOf(int32_t coordinate) const; // Floor division, so negative coordinates get their own cells
+    static uint64_t pack(int32_t cx, int32_t cy) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) | static_cast<uint32_t>(cy);
+    }
+};
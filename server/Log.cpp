@@ -0,0 +1,284 @@
+#include "Log.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+namespace Log {
+
+namespace {
+
+constexpr std::chrono::milliseconds FLUSH_INTERVAL{10};
+
+// Single producer (the owning thread), single consumer (the writer thread)
+struct Ring {
+    static constexpr uint64_t CAPACITY = 512;
+
+    Record records[CAPACITY];
+    alignas(64) std::atomic<uint64_t> head{0}; // Next record to publish, written by the owner
+    alignas(64) std::atomic<uint64_t> tail{0}; // Next record to drain, written by the writer
+    std::atomic<bool> retired{false};          // Owner has exited; dropped once drained
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<Ring>> rings;
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+struct ThreadRing {
+    std::shared_ptr<Ring> ring;
+
+    ~ThreadRing() {
+        if (ring) {
+            ring->retired.store(true, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadRing t_ring;
+std::atomic<uint64_t> g_dropped{0};
+
+Ring& threadRing() {
+    if (!t_ring.ring) {
+        t_ring.ring = std::make_shared<Ring>();
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.rings.push_back(t_ring.ring);
+    }
+    return *t_ring.ring;
+}
+
+const char* levelName(Level level) {
+    switch (level) {
+        case Level::Debug: return "DEBUG";
+        case Level::Info: return "INFO ";
+        case Level::Warn: return "WARN ";
+        case Level::Error: return "ERROR";
+        default: return "?    ";
+    }
+}
+
+void appendArg(std::string& out, const Record& record, const Arg& arg) {
+    char buffer[32];
+    switch (arg.type) {
+        case Arg::Type::Int: std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(arg.i)); break;
+        case Arg::Type::UInt: std::snprintf(buffer, sizeof(buffer), "%llu", static_cast<unsigned long long>(arg.u)); break;
+        case Arg::Type::Double: std::snprintf(buffer, sizeof(buffer), "%g", arg.d); break;
+        case Arg::Type::Bool: std::snprintf(buffer, sizeof(buffer), "%s", arg.u ? "true" : "false"); break;
+        case Arg::Type::Text:
+            out.append(record.text + arg.textOffset, arg.textLength);
+            return;
+    }
+    out += buffer;
+}
+
+// "2026-01-31T12:00:00.123456Z INFO  [Component] message\n"
+void format(std::string& out, const Record& record) {
+    time_t seconds = static_cast<time_t>(record.timeNs / 1000000000);
+    struct tm utc;
+    gmtime_r(&seconds, &utc);
+    char stamp[48];
+    size_t length = std::strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &utc);
+    std::snprintf(stamp + length, sizeof(stamp) - length, ".%06uZ ",
+                  static_cast<unsigned>((record.timeNs / 1000) % 1000000));
+
+    out += stamp;
+    out += levelName(record.level);
+    out += " [";
+    out += record.component;
+    out += "] ";
+
+    size_t nextArg = 0;
+    for (const char* p = record.format; *p; ++p) {
+        if (p[0] == '{' && p[1] == '}' && nextArg < record.argCount) {
+            appendArg(out, record, record.args[nextArg++]);
+            ++p;
+        } else {
+            out += *p;
+        }
+    }
+    for (; nextArg < record.argCount; ++nextArg) {
+        out += ' ';
+        appendArg(out, record, record.args[nextArg]);
+    }
+    out += '\n';
+}
+
+class Writer {
+public:
+    ~Writer() { stop(); }
+
+    void start() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_running) {
+            return;
+        }
+        m_running = true;
+        m_thread = std::thread(&Writer::run, this);
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_running) {
+                return;
+            }
+            m_running = false;
+        }
+        m_wake.notify_all();
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+
+private:
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_running = false;
+
+    // Writer thread only
+    std::vector<std::shared_ptr<Ring>> m_rings;
+    std::vector<Record> m_batch;
+    std::string m_out;
+    std::string m_errors;
+    uint64_t m_reportedDropped = 0;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_running) {
+            lock.unlock();
+            drain();
+            lock.lock();
+            m_wake.wait_for(lock, FLUSH_INTERVAL, [this] { return !m_running; });
+        }
+        lock.unlock();
+        drain();
+    }
+
+    void drain() {
+        Registry& reg = registry();
+        {
+            std::lock_guard<std::mutex> lock(reg.mutex);
+            m_rings = reg.rings;
+        }
+
+        // Copy the records out so their slots are free again before formatting
+        m_batch.clear();
+        for (const auto& ring : m_rings) {
+            bool retired = ring->retired.load(std::memory_order_acquire);
+            uint64_t head = ring->head.load(std::memory_order_acquire);
+            uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+            for (; tail != head; ++tail) {
+                m_batch.push_back(ring->records[tail % Ring::CAPACITY]);
+            }
+            ring->tail.store(head, std::memory_order_release);
+
+            if (retired) {
+                std::lock_guard<std::mutex> lock(reg.mutex);
+                reg.rings.erase(std::remove(reg.rings.begin(), reg.rings.end(), ring), reg.rings.end());
+            }
+        }
+        m_rings.clear();
+
+        // Rings are per thread; interleave them back into time order
+        std::stable_sort(m_batch.begin(), m_batch.end(),
+                         [](const Record& a, const Record& b) { return a.timeNs < b.timeNs; });
+
+        m_out.clear();
+        m_errors.clear();
+        for (const Record& record : m_batch) {
+            format(record.level >= Level::Warn ? m_errors : m_out, record);
+        }
+
+        uint64_t dropped = g_dropped.load(std::memory_order_relaxed);
+        if (dropped != m_reportedDropped) {
+            char note[96];
+            std::snprintf(note, sizeof(note), "[Log] %llu records dropped (log rings full)\n",
+                          static_cast<unsigned long long>(dropped - m_reportedDropped));
+            m_errors += note;
+            m_reportedDropped = dropped;
+        }
+
+        if (!m_out.empty()) {
+            std::fwrite(m_out.data(), 1, m_out.size(), stdout);
+            std::fflush(stdout);
+        }
+        if (!m_errors.empty()) {
+            std::fwrite(m_errors.data(), 1, m_errors.size(), stderr);
+            std::fflush(stderr);
+        }
+    }
+};
+
+Writer& writer() {
+    registry(); // Constructed first so it outlives the writer's final drain
+    static Writer instance;
+    return instance;
+}
+
+} // namespace
+
+void start() {
+    writer().start();
+}
+
+void stop() {
+    writer().stop();
+}
+
+uint64_t droppedCount() {
+    return g_dropped.load(std::memory_order_relaxed);
+}
+
+void Record::add(std::string_view value) {
+    size_t length = std::min(value.size(), TEXT_CAPACITY - textUsed);
+    std::memcpy(text + textUsed, value.data(), length);
+    Arg& arg = next(Arg::Type::Text);
+    arg.textOffset = textUsed;
+    arg.textLength = static_cast<uint8_t>(length);
+    textUsed += static_cast<uint8_t>(length);
+}
+
+Arg& Record::next(Arg::Type type) {
+    Arg& arg = args[argCount++];
+    arg.type = type;
+    return arg;
+}
+
+Record* claim(Level level, const char* component, const char* format) {
+    Ring& ring = threadRing();
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) == Ring::CAPACITY) {
+        g_dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Record& record = ring.records[head % Ring::CAPACITY];
+    record.timeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    record.component = component;
+    record.format = format;
+    record.level = level;
+    record.argCount = 0;
+    record.textUsed = 0;
+    return &record;
+}
+
+void commit() {
+    Ring& ring = *t_ring.ring;
+    ring.head.store(ring.head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+} // namespace Log
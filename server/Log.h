@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <cstdint>
+#include <cstddef>
+
+// Asynchronous logger. A log call copies its level, component, format string
+// pointer and arguments into a fixed-size record in a ring owned by the calling
+// thread and returns; a background thread drains the rings, merges them by time,
+// formats and writes. Logging therefore never locks, never allocates (after a
+// thread's first call, which registers its ring) and never waits on the console.
+// When a ring is full the record is dropped and counted instead of blocking.
+//
+//   LOG_INFO("GameState", "Player {} spawned at ({}, {})", playerId, x, y);
+//
+// Format strings and component names must be string literals (only the pointer is
+// kept). Each {} takes the next argument: integers, floating point, bool, and
+// strings (copied, truncated to the record's text space).
+//
+// Levels below LOG_MIN_LEVEL are compiled out, arguments included.
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_ERROR 3
+
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_LEVEL_INFO
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(component, ...) ::Log::write(::Log::Level::Debug, component, __VA_ARGS__)
+#else
+#define LOG_DEBUG(component, ...) do {} while (0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(component, ...) ::Log::write(::Log::Level::Info, component, __VA_ARGS__)
+#else
+#define LOG_INFO(component, ...) do {} while (0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_WARN
+#define LOG_WARN(component, ...) ::Log::write(::Log::Level::Warn, component, __VA_ARGS__)
+#else
+#define LOG_WARN(component, ...) do {} while (0)
+#endif
+
+#define LOG_ERROR(component, ...) ::Log::write(::Log::Level::Error, component, __VA_ARGS__)
+
+namespace Log {
+
+enum class Level : uint8_t {
+    Debug = LOG_LEVEL_DEBUG,
+    Info = LOG_LEVEL_INFO,
+    Warn = LOG_LEVEL_WARN,
+    Error = LOG_LEVEL_ERROR
+};
+
+// Starts the writer thread; records logged before then wait in their rings
+void start();
+// Writes everything logged so far and stops the writer thread
+void stop();
+
+uint64_t droppedCount(); // Records lost to full rings
+
+constexpr size_t MAX_ARGS = 8;
+constexpr size_t TEXT_CAPACITY = 96; // Shared by a record's string arguments
+
+struct Arg {
+    enum class Type : uint8_t { Int, UInt, Double, Bool, Text };
+    Type type;
+    uint8_t textLength; // Text: bytes in Record::text starting at textOffset
+    uint8_t textOffset;
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+    };
+};
+
+struct Record {
+    uint64_t timeNs;           // Wall clock
+    const char* component;
+    const char* format;
+    Level level;
+    uint8_t argCount;
+    uint8_t textUsed;
+    Arg args[MAX_ARGS];
+    char text[TEXT_CAPACITY];
+
+    void add(std::string_view value);
+    void add(const std::string& value) { add(std::string_view(value)); }
+    void add(const char* value) { add(value ? std::string_view(value) : std::string_view("(null)")); }
+    void add(bool value) {
+        Arg& arg = next(Arg::Type::Bool);
+        arg.u = value;
+    }
+    template <typename T>
+    std::enable_if_t<std::is_integral_v<T> && std::is_signed_v<T>> add(T value) {
+        next(Arg::Type::Int).i = value;
+    }
+    template <typename T>
+    std::enable_if_t<std::is_integral_v<T> && std::is_unsigned_v<T>> add(T value) {
+        next(Arg::Type::UInt).u = value;
+    }
+    template <typename T>
+    std::enable_if_t<std::is_floating_point_v<T>> add(T value) {
+        next(Arg::Type::Double).d = value;
+    }
+
+private:
+    Arg& next(Arg::Type type);
+};
+
+// The calling thread's next free record, or nullptr if its ring is full
+Record* claim(Level level, const char* component, const char* format);
+void commit(); // Publishes the record returned by the last claim() on this thread
+
+template <typename... Args>
+void write(Level level, const char* component, const char* format, const Args&... args) {
+    static_assert(sizeof...(Args) <= MAX_ARGS, "too many log arguments");
+    Record* record = claim(level, component, format);
+    if (!record) {
+        return;
+    }
+    (record->add(args), ...);
+    commit();
+}
+
+} // namespace Log
@@ -1,158 +1,374 @@
 #include "MatchmakingSystem.h"
 #include "WebSocketServer.h"
+#include "Log.h"
 #include <json/json.h>
-#include <iostream>
 #include <algorithm>
 #include <random>
 #include <sstream>
 #include <iomanip>
 #include <chrono>
 #include <vector>
+#include <iterator>
+
+namespace {
+
+// Game modes reported by name in stats. Clients may queue for any mode, so the rest are
+// lumped together to keep the set of metric labels bounded.
+const char* const KNOWN_GAME_MODES[] = {"default", "deathmatch", "team", "battle_royale", "bench"};
+
+const char* statsGameMode(const std::string& gameMode) {
+    for (const char* known : KNOWN_GAME_MODES) {
+        if (gameMode == known) {
+            return known;
+        }
+    }
+    return "other";
+}
+
+// Adds players rated within window of rating, closest first, until group holds limit
+void collectByRating(const std::multimap<int, uint64_t>& index, int rating, int window, uint64_t self,
+                     size_t limit, std::vector<uint64_t>& group) {
+    auto up = index.lower_bound(rating);
+    auto down = up;
+    while (group.size() < limit) {
+        bool canUp = up != index.end() && up->first - rating <= window;
+        bool canDown = down != index.begin() && rating - std::prev(down)->first <= window;
+        if (!canUp && !canDown) {
+            break;
+        }
+        
+        uint64_t playerId;
+        if (canUp && (!canDown || up->first - rating <= rating - std::prev(down)->first)) {
+            playerId = (up++)->second;
+        } else {
+            playerId = (--down)->second;
+        }
+        if (playerId != self) {
+            group.push_back(playerId);
+        }
+    }
+}
+
+} // namespace
 
 MatchmakingSystem::MatchmakingSystem(PlayerManager* playerManager, WebSocketServer* wsServer) 
-    : m_playerManager(playerManager), m_wsServer(wsServer) {
+    : m_playerManager(playerManager), m_wsServer(wsServer), m_timeToMatch(TIME_TO_MATCH_SAMPLES), m_timeToMatchCount(0),
+      m_running(false), m_batches(0), m_matchesFormed(0), m_lastBatchUs(0), m_maxBatchUs(0) {
 }
 
 MatchmakingSystem::~MatchmakingSystem() {
+    stop();
+}
+
+void MatchmakingSystem::start(std::chrono::milliseconds interval) {
+    if (m_running) {
+        return;
+    }
+    m_running = true;
+    m_thread = std::thread(&MatchmakingSystem::matchmakingLoop, this, interval);
+    LOG_INFO("Matchmaking", "Started, pass every {}ms", interval.count());
+}
+
+void MatchmakingSystem::stop() {
+    m_running = false;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void MatchmakingSystem::matchmakingLoop(std::chrono::milliseconds interval) {
+    auto deadline = std::chrono::steady_clock::now();
+    while (m_running) {
+        auto start = std::chrono::steady_clock::now();
+        process();
+        
+        uint64_t elapsedUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count());
+        m_batches.fetch_add(1, std::memory_order_relaxed);
+        m_lastBatchUs.store(elapsedUs, std::memory_order_relaxed);
+        m_batchDurations.observe(elapsedUs);
+        if (elapsedUs > m_maxBatchUs.load(std::memory_order_relaxed)) {
+            m_maxBatchUs.store(elapsedUs, std::memory_order_relaxed);
+        }
+        
+        // Absolute deadlines; a late pass isn't repeated
+        deadline += interval;
+        auto now = std::chrono::steady_clock::now();
+        if (deadline < now) {
+            deadline = now;
+        }
+        std::this_thread::sleep_until(deadline);
+    }
+}
+
+void MatchmakingSystem::setOnMatchCreated(MatchCreatedCallback callback) {
+    m_onMatchCreated = callback;
+}
+
+void MatchmakingSystem::setOnMatchEnded(MatchEndedCallback callback) {
+    m_onMatchEnded = callback;
 }
 
 void MatchmakingSystem::queuePlayer(uint64_t playerId, const std::string& gameMode, int minPlayers, int maxPlayers) {
-    MatchmakingRequest request;
-    request.playerId = playerId;
-    request.gameMode = gameMode;
-    request.minPlayers = minPlayers;
-    request.maxPlayers = maxPlayers;
-    request.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+    minPlayers = std::max(2, minPlayers);
+    maxPlayers = std::max(minPlayers, maxPlayers);
+    
+    int rating = 0;
+    int latencyTier = 0;
+    PlayerManager::PlayerSnapshot player = m_playerManager->getPlayer(playerId);
+    if (player) {
+        rating = player->rating;
+        latencyTier = std::clamp(static_cast<int>(player->latency) / LATENCY_TIER_MS, 0, LATENCY_TIERS - 1);
+    }
+    
+    uint64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
         std::chrono::steady_clock::now().time_since_epoch()).count();
     
     std::lock_guard<std::mutex> lock(m_queueMutex);
-    m_queue.push(request);
-    std::cout << "[Matchmaking] Player " << playerId << " queued for " << gameMode 
-              << " (min: " << minPlayers << ", max: " << maxPlayers << ")" << std::endl;
-    std::cout << "[Matchmaking] Queue size: " << m_queue.size() << std::endl;
-}
-
-void MatchmakingSystem::queuePlayer(uint64_t playerId, const Json::Value& requestData) {
-    std::string gameMode = requestData.get("gameMode", "default").asString();
-    int minPlayers = requestData.get("minPlayers", 2).asInt();
-    int maxPlayers = requestData.get("maxPlayers", 4).asInt();
+    removeFromPoolLocked(playerId); // Queueing again replaces the previous request
     
-    queuePlayer(playerId, gameMode, minPlayers, maxPlayers);
+    PoolBucket& bucket = m_buckets[BucketKey(gameMode, minPlayers, maxPlayers)];
+    if (bucket.tiers.empty()) {
+        bucket.gameMode = gameMode;
+        bucket.minPlayers = minPlayers;
+        bucket.maxPlayers = maxPlayers;
+        bucket.tiers.resize(LATENCY_TIERS);
+    }
+    bucket.size++;
+    
+    PoolEntry entry;
+    entry.bucket = &bucket;
+    entry.rating = rating;
+    entry.latencyTier = latencyTier;
+    entry.queuedAt = now;
+    entry.ratingPos = bucket.tiers[latencyTier].emplace(rating, playerId);
+    entry.reviewPos = m_reviews.emplace(now + WINDOW_STEP_MS, playerId);
+    m_pool.emplace(playerId, entry);
+    m_arrivals.push_back(playerId);
+    
+    LOG_INFO("Matchmaking", "Player {} queued for {} (min: {}, max: {})", playerId, gameMode, minPlayers, maxPlayers);
+    LOG_DEBUG("Matchmaking", "Queue size: {}", m_pool.size());
 }
 
 void MatchmakingSystem::removePlayer(uint64_t playerId) {
-    std::lock_guard<std::mutex> lock(m_queueMutex);
-    
-    // Remove from queue
-    std::queue<MatchmakingRequest> newQueue;
-    while (!m_queue.empty()) {
-        if (m_queue.front().playerId != playerId) {
-            newQueue.push(m_queue.front());
+    std::string endedMatchId;
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        
+        // Remove from queue
+        removeFromPoolLocked(playerId);
+        
+        // Remove from match
+        std::lock_guard<std::mutex> matchLock(m_matchesMutex);
+        auto it = m_playerToMatch.find(playerId);
+        if (it != m_playerToMatch.end()) {
+            std::string matchId = it->second;
+            m_playerToMatch.erase(it);
+            
+            auto matchIt = m_matches.find(matchId);
+            if (matchIt != m_matches.end()) {
+                auto& players = matchIt->second.players;
+                players.erase(std::remove(players.begin(), players.end(), playerId), players.end());
+                
+                if (players.empty()) {
+                    m_matches.erase(matchIt);
+                    if (!deferEndLocked(matchId)) {
+                        endedMatchId = matchId;
+                    }
+                }
+            }
         }
-        m_queue.pop();
     }
-    m_queue = newQueue;
     
-    // Remove from match
-    std::lock_guard<std::mutex> matchLock(m_matchesMutex);
-    auto it = m_playerToMatch.find(playerId);
-    if (it != m_playerToMatch.end()) {
-        std::string matchId = it->second;
-        m_playerToMatch.erase(it);
+    if (!endedMatchId.empty() && m_onMatchEnded) {
+        m_onMatchEnded(endedMatchId);
+    }
+}
+
+void MatchmakingSystem::process() {
+    std::vector<Match> formed;
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        uint64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        
+        // New arrivals first, then players whose window has widened since they were last tried
+        std::vector<uint64_t> arrivals;
+        arrivals.swap(m_arrivals);
+        for (uint64_t playerId : arrivals) {
+            tryMatchLocked(playerId, now, formed);
+        }
         
-        auto matchIt = m_matches.find(matchId);
-        if (matchIt != m_matches.end()) {
-            auto& players = matchIt->second.players;
-            players.erase(std::remove(players.begin(), players.end(), playerId), players.end());
+        while (!m_reviews.empty() && m_reviews.begin()->first <= now) {
+            uint64_t playerId = m_reviews.begin()->second;
+            if (tryMatchLocked(playerId, now, formed)) {
+                continue;
+            }
             
-            if (players.empty()) {
-                m_matches.erase(matchIt);
+            // Still waiting; look again at the next widening
+            PoolEntry& entry = m_pool.find(playerId)->second;
+            uint64_t nextStep = (now - entry.queuedAt) / WINDOW_STEP_MS + 1;
+            m_reviews.erase(entry.reviewPos);
+            entry.reviewPos = m_reviews.emplace(entry.queuedAt + nextStep * WINDOW_STEP_MS, playerId);
+        }
+    }
+    
+    for (const Match& match : formed) {
+        LOG_INFO("Matchmaking", "Creating match with {} players for game mode: {}", match.players.size(), match.gameMode);
+        createMatch(match.players, match.gameMode);
+    }
+}
+
+size_t MatchmakingSystem::dispatchMatches(std::chrono::milliseconds timeout) {
+    std::vector<Match> ready;
+    {
+        std::unique_lock<std::mutex> lock(m_readyMutex);
+        if (!m_readyCondition.wait_for(lock, timeout, [this] { return !m_readyMatches.empty(); })) {
+            return 0;
+        }
+        ready.swap(m_readyMatches);
+    }
+    
+    size_t dispatched = 0;
+    for (Match& match : ready) {
+        {
+            // Players who left while the match was queued here are already out of it
+            std::lock_guard<std::mutex> lock(m_matchesMutex);
+            auto it = m_matches.find(match.matchId);
+            if (it == m_matches.end()) {
+                continue;
             }
+            match.players = it->second.players;
+            m_dispatching[match.matchId] = false;
+        }
+        
+        // World must exist before clients learn about the match and start sending actions
+        if (m_onMatchCreated) {
+            m_onMatchCreated(match);
+        }
+        notifyMatchCreated(match);
+        dispatched++;
+        
+        // Everyone left while the world was being set up; tear it down now that it exists
+        bool ended;
+        {
+            std::lock_guard<std::mutex> lock(m_matchesMutex);
+            auto it = m_dispatching.find(match.matchId);
+            ended = it->second;
+            m_dispatching.erase(it);
+        }
+        if (ended && m_onMatchEnded) {
+            m_onMatchEnded(match.matchId);
         }
     }
+    return dispatched;
 }
 
-void MatchmakingSystem::process() {
+size_t MatchmakingSystem::getQueuedPlayerCount() const {
     std::lock_guard<std::mutex> lock(m_queueMutex);
-    
-    if (m_queue.size() < 2) {
-        return; // Need at least 2 players
+    return m_pool.size();
+}
+
+MatchmakingStats MatchmakingSystem::getStats() const {
+    MatchmakingStats stats;
+    std::vector<uint64_t> samples;
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        stats.queuedPlayers = m_pool.size();
+        for (const auto& pair : m_buckets) {
+            stats.queuedByGameMode[statsGameMode(pair.second.gameMode)] += pair.second.size;
+        }
+        size_t count = std::min(m_timeToMatchCount, TIME_TO_MATCH_SAMPLES);
+        samples.assign(m_timeToMatch.begin(), m_timeToMatch.begin() + count);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_readyMutex);
+        stats.pendingMatches = m_readyMatches.size();
     }
+    {
+        std::lock_guard<std::mutex> lock(m_matchesMutex);
+        stats.activeMatches = m_matches.size();
+    }
+    stats.batches = m_batches.load(std::memory_order_relaxed);
+    stats.matchesFormed = m_matchesFormed.load(std::memory_order_relaxed);
+    stats.lastBatchUs = m_lastBatchUs.load(std::memory_order_relaxed);
+    stats.maxBatchUs = m_maxBatchUs.load(std::memory_order_relaxed);
     
-    std::cout << "[Matchmaking] Processing queue with " << m_queue.size() << " players" << std::endl;
+    auto percentile = [&samples](double p) -> uint64_t {
+        if (samples.empty()) {
+            return 0;
+        }
+        size_t rank = std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()));
+        std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+        return samples[rank];
+    };
+    stats.timeToMatchP50Ms = percentile(0.50);
+    stats.timeToMatchP90Ms = percentile(0.90);
+    stats.timeToMatchP99Ms = percentile(0.99);
+    return stats;
+}
+
+void MatchmakingSystem::cancelQueue(uint64_t playerId) {
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    removeFromPoolLocked(playerId);
+}
+
+bool MatchmakingSystem::removeFromPoolLocked(uint64_t playerId) {
+    auto it = m_pool.find(playerId);
+    if (it == m_pool.end()) {
+        return false;
+    }
     
-    // Group players by game mode
-    std::unordered_map<std::string, std::vector<MatchmakingRequest>> byGameMode;
+    PoolEntry& entry = it->second;
+    PoolBucket* bucket = entry.bucket;
+    bucket->tiers[entry.latencyTier].erase(entry.ratingPos);
+    m_reviews.erase(entry.reviewPos);
+    m_pool.erase(it);
     
-    std::queue<MatchmakingRequest> tempQueue = m_queue;
-    while (!tempQueue.empty()) {
-        auto request = tempQueue.front();
-        tempQueue.pop();
-        
-        if (m_playerManager->playerExists(request.playerId)) {
-            byGameMode[request.gameMode].push_back(request);
-        }
+    if (--bucket->size == 0) {
+        m_buckets.erase(BucketKey(bucket->gameMode, bucket->minPlayers, bucket->maxPlayers));
+    }
+    return true;
+}
+
+bool MatchmakingSystem::tryMatchLocked(uint64_t playerId, uint64_t now, std::vector<Match>& formed) {
+    auto it = m_pool.find(playerId);
+    if (it == m_pool.end()) {
+        return false; // Already matched earlier in this pass
     }
     
-    // Try to form matches for each game mode
-    for (auto& pair : byGameMode) {
-        auto& requests = pair.second;
-        
-        while (requests.size() >= 2) {
-            // Find a group that can form a match
-            std::vector<MatchmakingRequest> matchGroup;
-            std::string gameMode = pair.first;
-            
-            int minPlayers = requests[0].minPlayers;
-            int maxPlayers = requests[0].maxPlayers;
-            
-            // Take up to maxPlayers from the queue
-            for (size_t i = 0; i < requests.size() && matchGroup.size() < static_cast<size_t>(maxPlayers); ++i) {
-                if (requests[i].gameMode == gameMode) {
-                    matchGroup.push_back(requests[i]);
-                }
-            }
-            
-            if (matchGroup.size() >= static_cast<size_t>(minPlayers)) {
-                // Create match
-                std::vector<uint64_t> playerIds;
-                for (const auto& req : matchGroup) {
-                    playerIds.push_back(req.playerId);
-                }
-                
-                std::cout << "[Matchmaking] Creating match with " << playerIds.size() 
-                          << " players for game mode: " << gameMode << std::endl;
-                createMatch(playerIds, gameMode);
-                
-                // Remove matched players from queue
-                for (const auto& req : matchGroup) {
-                    requests.erase(
-                        std::remove_if(requests.begin(), requests.end(),
-                            [&req](const MatchmakingRequest& r) { return r.playerId == req.playerId; }),
-                        requests.end());
-                }
-                
-                // Remove from main queue
-                std::queue<MatchmakingRequest> newQueue;
-                while (!m_queue.empty()) {
-                    bool shouldRemove = false;
-                    for (const auto& req : matchGroup) {
-                        if (m_queue.front().playerId == req.playerId) {
-                            shouldRemove = true;
-                            break;
-                        }
-                    }
-                    if (!shouldRemove) {
-                        newQueue.push(m_queue.front());
-                    }
-                    m_queue.pop();
-                }
-                m_queue = newQueue;
-            } else {
-                break; // Not enough players for this game mode
+    const PoolEntry& anchor = it->second;
+    const PoolBucket& bucket = *anchor.bucket;
+    size_t maxPlayers = static_cast<size_t>(bucket.maxPlayers);
+    
+    uint64_t steps = (now - anchor.queuedAt) / WINDOW_STEP_MS;
+    int window = static_cast<int>(std::min<uint64_t>(BASE_RATING_WINDOW + steps * RATING_WINDOW_STEP, MAX_RATING_WINDOW));
+    int reach = static_cast<int>(std::min<uint64_t>(steps / TIER_WIDEN_STEPS, LATENCY_TIERS - 1));
+    
+    // Own latency tier first, then one tier further out each way
+    std::vector<uint64_t> group{playerId};
+    for (int distance = 0; distance <= reach && group.size() < maxPlayers; ++distance) {
+        int tiers[2] = {anchor.latencyTier - distance, anchor.latencyTier + distance};
+        for (int i = 0; i < (distance == 0 ? 1 : 2); ++i) {
+            if (tiers[i] >= 0 && tiers[i] < LATENCY_TIERS) {
+                collectByRating(bucket.tiers[tiers[i]], anchor.rating, window, playerId, maxPlayers, group);
             }
         }
     }
+    
+    if (group.size() < static_cast<size_t>(bucket.minPlayers)) {
+        return false;
+    }
+    
+    Match match{};
+    match.players = group;
+    match.gameMode = bucket.gameMode;
+    for (uint64_t member : group) {
+        m_timeToMatch[m_timeToMatchCount++ % TIME_TO_MATCH_SAMPLES] = now - m_pool.find(member)->second.queuedAt;
+        removeFromPoolLocked(member); // May drop the bucket; nothing above is used after this
+    }
+    formed.push_back(std::move(match));
+    return true;
 }
 
 std::string MatchmakingSystem::generateMatchId() {
@@ -168,7 +384,7 @@ std::string MatchmakingSystem::generateMatchId() {
 }
 
 void MatchmakingSystem::createMatch(const std::vector<uint64_t>& players, const std::string& gameMode) {
-    std::lock_guard<std::mutex> lock(m_matchesMutex);
+    std::unique_lock<std::mutex> lock(m_matchesMutex);
     
     Match match;
     match.matchId = generateMatchId();
@@ -185,7 +401,14 @@ void MatchmakingSystem::createMatch(const std::vector<uint64_t>& players, const
         m_playerManager->setPlayerInMatch(playerId, true, match.matchId);
     }
     
-    notifyMatchCreated(match);
+    lock.unlock();
+    m_matchesFormed.fetch_add(1, std::memory_order_relaxed);
+    
+    {
+        std::lock_guard<std::mutex> readyLock(m_readyMutex);
+        m_readyMatches.push_back(std::move(match));
+    }
+    m_readyCondition.notify_one();
 }
 
 void MatchmakingSystem::notifyMatchCreated(const Match& match) {
@@ -200,7 +423,7 @@ void MatchmakingSystem::notifyMatchCreated(const Match& match) {
     }
     notification["players"] = playersJson;
     
-    std::string message = notification.toStyledString();
+    auto message = WebSocketServer::makeBuffer(notification.toStyledString());
     
     if (m_wsServer) {
         // Send to all players in the match
@@ -223,32 +446,48 @@ Match* MatchmakingSystem::getMatch(const std::string& matchId) {
 Match* MatchmakingSystem::getPlayerMatch(uint64_t playerId) {
     std::lock_guard<std::mutex> lock(m_matchesMutex);
     auto it = m_playerToMatch.find(playerId);
-    if (it != m_playerToMatch.end()) {
-        return getMatch(it->second);
+    if (it == m_playerToMatch.end()) {
+        return nullptr;
     }
-    return nullptr;
+    
+    // Look up directly; getMatch would take m_matchesMutex again
+    auto matchIt = m_matches.find(it->second);
+    return matchIt != m_matches.end() ? &matchIt->second : nullptr;
 }
 
-void MatchmakingSystem::endMatch(const std::string& matchId) {
+bool MatchmakingSystem::isPlayerInMatch(uint64_t playerId, const std::string& matchId) const {
     std::lock_guard<std::mutex> lock(m_matchesMutex);
-    auto it = m_matches.find(matchId);
-    if (it != m_matches.end()) {
+    auto it = m_playerToMatch.find(playerId);
+    return it != m_playerToMatch.end() && it->second == matchId;
+}
+
+void MatchmakingSystem::endMatch(const std::string& matchId) {
+    {
+        std::lock_guard<std::mutex> lock(m_matchesMutex);
+        auto it = m_matches.find(matchId);
+        if (it == m_matches.end()) {
+            return;
+        }
         for (uint64_t playerId : it->second.players) {
             m_playerToMatch.erase(playerId);
             m_playerManager->setPlayerInMatch(playerId, false, "");
         }
         m_matches.erase(it);
+        if (deferEndLocked(matchId)) {
+            return;
+        }
+    }
+    
+    if (m_onMatchEnded) {
+        m_onMatchEnded(matchId);
     }
 }
 
-bool MatchmakingSystem::canFormMatch(const MatchmakingRequest& request, const std::vector<MatchmakingRequest>& candidates) {
-    // Check if we can form a match with the given candidates
-    int count = 1; // Include the request itself
-    for (const auto& candidate : candidates) {
-        if (candidate.gameMode == request.gameMode) {
-            count++;
-        }
+bool MatchmakingSystem::deferEndLocked(const std::string& matchId) {
+    auto it = m_dispatching.find(matchId);
+    if (it == m_dispatching.end()) {
+        return false;
     }
-    return count >= request.minPlayers && count <= request.maxPlayers;
+    it->second = true;
+    return true;
 }
-
@@ -1,24 +1,23 @@
 #pragma once
 
 #include "PlayerManager.h"
+#include "Metrics.h"
 #include <json/json.h>
-#include <queue>
 #include <vector>
 #include <string>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <tuple>
 #include <unordered_map>
 #include <cstdint>
+#include <functional>
 
 class WebSocketServer;
 
-struct MatchmakingRequest {
-    uint64_t playerId;
-    std::string gameMode;
-    int minPlayers;
-    int maxPlayers;
-    uint64_t timestamp;
-};
-
 struct Match {
     std::string matchId;
     std::vector<uint64_t> players;
@@ -27,35 +26,139 @@ struct Match {
     bool isActive;
 };
 
+struct MatchmakingStats {
+    size_t queuedPlayers = 0;
+    std::map<std::string, size_t> queuedByGameMode; // Known modes by name, any other under "other"
+    size_t pendingMatches = 0; // Formed, not yet picked up by the game side
+    size_t activeMatches = 0;
+    uint64_t batches = 0;
+    uint64_t matchesFormed = 0;
+    uint64_t lastBatchUs = 0;
+    uint64_t maxBatchUs = 0;
+    uint64_t timeToMatchP50Ms = 0; // Over the last TIME_TO_MATCH_SAMPLES matched players
+    uint64_t timeToMatchP90Ms = 0;
+    uint64_t timeToMatchP99Ms = 0;
+};
+
+// Matchmaking pool. Queued players are bucketed by (game mode, min players, max
+// players); inside a bucket they are split into latency tiers (Player::latency)
+// and kept sorted by Player::rating. A player is matched when enough others fall
+// inside their rating window in their own or a nearby latency tier. Both the
+// rating window and the tier reach widen the longer the player waits.
+//
+// Each pass only tries players that just queued or whose window just widened,
+// so the cost of process() scales with those, not with the pool size.
+// Cancelling is O(1) by player ID.
+//
+// Passes run in batches on a dedicated matchmaking thread at their own cadence,
+// away from world ticks. Formed matches are queued for the game side, which picks
+// them up with dispatchMatches() and runs the match-created hook there.
 class MatchmakingSystem {
 public:
+    using MatchCreatedCallback = std::function<void(const Match&)>;
+    using MatchEndedCallback = std::function<void(const std::string&)>;
+    
     MatchmakingSystem(PlayerManager* playerManager, WebSocketServer* wsServer);
     ~MatchmakingSystem();
     
     void queuePlayer(uint64_t playerId, const std::string& gameMode, int minPlayers = 2, int maxPlayers = 4);
-    void queuePlayer(uint64_t playerId, const Json::Value& requestData); // JSON variant
     void removePlayer(uint64_t playerId);
+    void cancelQueue(uint64_t playerId); // Leaves the queue but keeps any match seat
+    
+    void start(std::chrono::milliseconds interval); // Runs process() every interval on its own thread
+    void stop();
+    void process(); // One batch pass; formed matches are queued for dispatchMatches()
     
-    void process(); // Called every tick to process matchmaking
+    // Game side: waits up to timeout for formed matches, then runs the match-created
+    // hook and notifies the players of each. Returns how many were dispatched.
+    size_t dispatchMatches(std::chrono::milliseconds timeout);
+    
+    size_t getQueuedPlayerCount() const;
+    MatchmakingStats getStats() const;
+    const Metrics::Histogram& getBatchDurations() const { return m_batchDurations; }
     
     Match* getMatch(const std::string& matchId);
     Match* getPlayerMatch(uint64_t playerId);
+    bool isPlayerInMatch(uint64_t playerId, const std::string& matchId) const;
     
     void endMatch(const std::string& matchId);
     
+    // Match lifecycle hooks, invoked without matchmaking locks held; match-created runs
+    // on the thread calling dispatchMatches(). A match that empties while its
+    // match-created hook runs gets match-ended once that hook returns, never during it.
+    void setOnMatchCreated(MatchCreatedCallback callback);
+    void setOnMatchEnded(MatchEndedCallback callback);
+
 private:
     PlayerManager* m_playerManager;
     WebSocketServer* m_wsServer;
-    std::queue<MatchmakingRequest> m_queue;
-    std::mutex m_queueMutex;
+    
+    // Bucket players of one (game mode, min, max); per latency tier, rating -> player
+    using BucketKey = std::tuple<std::string, int, int>;
+    using RatingIndex = std::multimap<int, uint64_t>;
+    struct PoolBucket {
+        std::string gameMode;
+        int minPlayers;
+        int maxPlayers;
+        std::vector<RatingIndex> tiers;
+        size_t size = 0; // Dropped when it empties
+    };
+    
+    struct PoolEntry {
+        PoolBucket* bucket;
+        int rating;
+        int latencyTier;
+        uint64_t queuedAt;
+        RatingIndex::iterator ratingPos;
+        std::multimap<uint64_t, uint64_t>::iterator reviewPos;
+    };
+    
+    std::map<BucketKey, PoolBucket> m_buckets;
+    std::unordered_map<uint64_t, PoolEntry> m_pool;
+    std::multimap<uint64_t, uint64_t> m_reviews; // When a player's window next widens -> player
+    std::vector<uint64_t> m_arrivals;            // Queued since the last pass
+    mutable std::mutex m_queueMutex;
+    
+    static constexpr int LATENCY_TIER_MS = 50;
+    static constexpr int LATENCY_TIERS = 8;       // The last tier holds everything slower
+    static constexpr uint64_t WINDOW_STEP_MS = 1000;
+    static constexpr int BASE_RATING_WINDOW = 100;
+    static constexpr int RATING_WINDOW_STEP = 50; // Per WINDOW_STEP_MS waited
+    static constexpr int MAX_RATING_WINDOW = 1000;
+    static constexpr uint64_t TIER_WIDEN_STEPS = 5; // Steps waited per extra latency tier reached
+    
+    // Time-to-match samples, a ring under m_queueMutex
+    std::vector<uint64_t> m_timeToMatch;
+    size_t m_timeToMatchCount;
+    static constexpr size_t TIME_TO_MATCH_SAMPLES = 4096;
+    
+    // Handoff to the game side
+    std::vector<Match> m_readyMatches;
+    mutable std::mutex m_readyMutex;
+    std::condition_variable m_readyCondition;
+    
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+    std::atomic<uint64_t> m_batches;
+    std::atomic<uint64_t> m_matchesFormed;
+    std::atomic<uint64_t> m_lastBatchUs;
+    std::atomic<uint64_t> m_maxBatchUs;
+    Metrics::Histogram m_batchDurations;
     
     std::unordered_map<std::string, Match> m_matches;
     std::unordered_map<uint64_t, std::string> m_playerToMatch;
-    std::mutex m_matchesMutex;
+    std::unordered_map<std::string, bool> m_dispatching; // Match-created running -> ended meanwhile
+    mutable std::mutex m_matchesMutex;
+    
+    MatchCreatedCallback m_onMatchCreated;
+    MatchEndedCallback m_onMatchEnded;
     
     std::string generateMatchId();
-    bool canFormMatch(const MatchmakingRequest& request, const std::vector<MatchmakingRequest>& candidates);
-    void createMatch(const std::vector<uint64_t>& players, const std::string& gameMode);
+    bool removeFromPoolLocked(uint64_t playerId);
+    bool tryMatchLocked(uint64_t playerId, uint64_t now, std::vector<Match>& formed);
+    void createMatch(const std::vector<uint64_t>& players, const std::string& gameMode); // Registers and queues for dispatch
+    void matchmakingLoop(std::chrono::milliseconds interval);
     void notifyMatchCreated(const Match& match);
+    bool deferEndLocked(const std::string& matchId); // True if the end waits for dispatch to finish
 };
 
@@ -0,0 +1,458 @@
+#include "MessageParser.h"
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace MessageParser {
+
+namespace {
+
+enum class Field : uint8_t {
+    Unknown,
+    Type,
+    GameMode,
+    MinPlayers,
+    MaxPlayers,
+    Message,
+    Channel,
+    ActionType,
+    ActionId,
+    Timestamp,
+    SequenceNumber,
+    Tick,
+    Latency,
+    Token,
+    LastTick,
+    Actions,
+    Data
+};
+
+enum class DataField : uint8_t {
+    Unknown,
+    Dx,
+    Dy
+};
+
+constexpr NameEntry<Field> FIELDS[] = {
+    entry("type", Field::Type),
+    entry("gameMode", Field::GameMode),
+    entry("minPlayers", Field::MinPlayers),
+    entry("maxPlayers", Field::MaxPlayers),
+    entry("message", Field::Message),
+    entry("channel", Field::Channel),
+    entry("actionType", Field::ActionType),
+    entry("actionId", Field::ActionId),
+    entry("timestamp", Field::Timestamp),
+    entry("sequenceNumber", Field::SequenceNumber),
+    entry("tick", Field::Tick),
+    entry("latency", Field::Latency),
+    entry("token", Field::Token),
+    entry("lastTick", Field::LastTick),
+    entry("actions", Field::Actions),
+    entry("data", Field::Data)
+};
+
+constexpr NameEntry<DataField> DATA_FIELDS[] = {
+    entry("dx", DataField::Dx),
+    entry("dy", DataField::Dy)
+};
+
+const int MAX_DEPTH = 32; // Nesting allowed inside skipped values
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Forward-only reader over a mutable JSON buffer
+class Cursor {
+public:
+    Cursor(char* data, size_t length) : m_pos(data), m_end(data + length) {}
+
+    bool consume(char c) {
+        skipWhitespace();
+        if (m_pos < m_end && *m_pos == c) {
+            ++m_pos;
+            return true;
+        }
+        return false;
+    }
+
+    bool peek(char c) {
+        skipWhitespace();
+        return m_pos < m_end && *m_pos == c;
+    }
+
+    bool atEnd() {
+        skipWhitespace();
+        return m_pos == m_end;
+    }
+
+    // Decodes escapes in place; out points into the buffer
+    bool readString(std::string_view& out) {
+        if (!consume('"')) {
+            return false;
+        }
+
+        char* start = m_pos;
+
+        // Fast path: no escapes
+        while (m_pos < m_end && *m_pos != '"' && *m_pos != '\\') {
+            if (static_cast<unsigned char>(*m_pos) < 0x20) return false;
+            ++m_pos;
+        }
+
+        char* write = m_pos;
+        while (m_pos < m_end && *m_pos != '"') {
+            char c = *m_pos++;
+            if (static_cast<unsigned char>(c) < 0x20) {
+                return false;
+            }
+            if (c != '\\') {
+                *write++ = c;
+                continue;
+            }
+            if (m_pos >= m_end) {
+                return false;
+            }
+
+            switch (*m_pos++) {
+                case '"': *write++ = '"'; break;
+                case '\\': *write++ = '\\'; break;
+                case '/': *write++ = '/'; break;
+                case 'b': *write++ = '\b'; break;
+                case 'f': *write++ = '\f'; break;
+                case 'n': *write++ = '\n'; break;
+                case 'r': *write++ = '\r'; break;
+                case 't': *write++ = '\t'; break;
+                case 'u': {
+                    uint32_t codePoint;
+                    if (!readHex4(codePoint)) return false;
+                    if (codePoint >= 0xD800 && codePoint <= 0xDBFF) {
+                        uint32_t low;
+                        if (m_end - m_pos < 2 || m_pos[0] != '\\' || m_pos[1] != 'u') return false;
+                        m_pos += 2;
+                        if (!readHex4(low) || low < 0xDC00 || low > 0xDFFF) return false;
+                        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                    } else if (codePoint >= 0xDC00 && codePoint <= 0xDFFF) {
+                        return false;
+                    }
+                    write = encodeUtf8(write, codePoint); // Never longer than the escape it replaces
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+
+        if (m_pos >= m_end) {
+            return false;
+        }
+        ++m_pos; // Closing quote
+        out = std::string_view(start, write - start);
+        return true;
+    }
+
+    // Integer targets truncate fractional values and clamp out-of-range ones
+    template <typename T>
+    bool readNumber(T& out) {
+        skipWhitespace();
+        const char* start = m_pos;
+        while (m_pos < m_end && ((*m_pos >= '0' && *m_pos <= '9') || *m_pos == '-' || *m_pos == '+' ||
+                                 *m_pos == '.' || *m_pos == 'e' || *m_pos == 'E')) {
+            ++m_pos;
+        }
+        if (start == m_pos) {
+            return false;
+        }
+
+        if constexpr (std::is_integral_v<T>) {
+            T value;
+            auto result = std::from_chars(start, m_pos, value);
+            if (result.ec == std::errc() && result.ptr == m_pos) {
+                out = value;
+                return true;
+            }
+        }
+
+        // strtod rather than floating-point from_chars, which Apple's libc++ lacks; the
+        // server never calls setlocale, so '.' is the decimal point
+        char text[64];
+        size_t length = static_cast<size_t>(m_pos - start);
+        if (length >= sizeof(text)) {
+            return false;
+        }
+        std::memcpy(text, start, length);
+        text[length] = '\0';
+        char* parsedEnd;
+        double real = std::strtod(text, &parsedEnd);
+        if (parsedEnd != text + length) {
+            return false;
+        }
+        if constexpr (std::is_floating_point_v<T>) {
+            out = static_cast<T>(real);
+        } else if (real <= static_cast<double>(std::numeric_limits<T>::min())) {
+            out = std::numeric_limits<T>::min();
+        } else if (real >= static_cast<double>(std::numeric_limits<T>::max())) {
+            out = std::numeric_limits<T>::max();
+        } else {
+            out = static_cast<T>(real);
+        }
+        return true;
+    }
+
+    bool skipValue(int depth = 0) {
+        skipWhitespace();
+        if (m_pos >= m_end || depth > MAX_DEPTH) {
+            return false;
+        }
+
+        switch (*m_pos) {
+            case '"': {
+                std::string_view ignored;
+                return readString(ignored);
+            }
+            case '{':
+            case '[': {
+                char close = (*m_pos == '{') ? '}' : ']';
+                bool isObject = (close == '}');
+                ++m_pos;
+                if (consume(close)) {
+                    return true;
+                }
+                do {
+                    if (isObject) {
+                        std::string_view key;
+                        if (!readString(key) || !consume(':')) return false;
+                    }
+                    if (!skipValue(depth + 1)) return false;
+                } while (consume(','));
+                return consume(close);
+            }
+            case 't': return skipLiteral("true");
+            case 'f': return skipLiteral("false");
+            case 'n': return skipLiteral("null");
+            default: {
+                double ignored;
+                return readNumber(ignored);
+            }
+        }
+    }
+
+    // Reads a string field, leaving out untouched if the value is another type
+    bool readStringField(std::string_view& out) {
+        return peek('"') ? readString(out) : skipValue();
+    }
+
+    template <typename T>
+    bool readNumberField(T& out) {
+        skipWhitespace();
+        if (m_pos < m_end && (*m_pos == '-' || (*m_pos >= '0' && *m_pos <= '9'))) {
+            return readNumber(out);
+        }
+        return skipValue();
+    }
+
+private:
+    char* m_pos;
+    char* m_end;
+
+    void skipWhitespace() {
+        while (m_pos < m_end && (*m_pos == ' ' || *m_pos == '\n' || *m_pos == '\r' || *m_pos == '\t')) {
+            ++m_pos;
+        }
+    }
+
+    bool skipLiteral(std::string_view literal) {
+        if (static_cast<size_t>(m_end - m_pos) < literal.size() ||
+            std::string_view(m_pos, literal.size()) != literal) {
+            return false;
+        }
+        m_pos += literal.size();
+        return true;
+    }
+
+    bool readHex4(uint32_t& out) {
+        if (m_end - m_pos < 4) {
+            return false;
+        }
+        out = 0;
+        for (int i = 0; i < 4; ++i) {
+            int digit = hexValue(*m_pos++);
+            if (digit < 0) return false;
+            out = (out << 4) | static_cast<uint32_t>(digit);
+        }
+        return true;
+    }
+
+    static char* encodeUtf8(char* out, uint32_t codePoint) {
+        if (codePoint < 0x80) {
+            *out++ = static_cast<char>(codePoint);
+        } else if (codePoint < 0x800) {
+            *out++ = static_cast<char>(0xC0 | (codePoint >> 6));
+            *out++ = static_cast<char>(0x80 | (codePoint & 0x3F));
+        } else if (codePoint < 0x10000) {
+            *out++ = static_cast<char>(0xE0 | (codePoint >> 12));
+            *out++ = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            *out++ = static_cast<char>(0x80 | (codePoint & 0x3F));
+        } else {
+            *out++ = static_cast<char>(0xF0 | (codePoint >> 18));
+            *out++ = static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+            *out++ = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            *out++ = static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+        return out;
+    }
+};
+
+bool parseActionData(Cursor& cursor, GameActionPayload& action) {
+    if (!cursor.peek('{')) {
+        return cursor.skipValue();
+    }
+    cursor.consume('{');
+    if (cursor.consume('}')) {
+        return true;
+    }
+
+    do {
+        std::string_view key;
+        if (!cursor.readString(key) || !cursor.consume(':')) {
+            return false;
+        }
+
+        bool ok;
+        switch (lookup(DATA_FIELDS, key, DataField::Unknown)) {
+            case DataField::Dx: ok = cursor.readNumberField(action.dx); break;
+            case DataField::Dy: ok = cursor.readNumberField(action.dy); break;
+            default: ok = cursor.skipValue(1); break;
+        }
+        if (!ok) {
+            return false;
+        }
+    } while (cursor.consume(','));
+
+    return cursor.consume('}');
+}
+
+// Fields shared by game_action and each element of game_actions; anything else is skipped
+bool parseActionField(Cursor& cursor, Field field, GameActionPayload& action) {
+    switch (field) {
+        case Field::ActionType: return cursor.readStringField(action.actionName);
+        case Field::ActionId: return cursor.readNumberField(action.actionId);
+        case Field::Timestamp:
+            action.hasTimestamp = true;
+            return cursor.readNumberField(action.timestamp);
+        case Field::SequenceNumber: return cursor.readNumberField(action.sequenceNumber);
+        case Field::Tick: return cursor.readNumberField(action.clientTick);
+        case Field::Data: return parseActionData(cursor, action);
+        default: return cursor.skipValue();
+    }
+}
+
+bool parseActionBatch(Cursor& cursor, GameActionBatchPayload& batch) {
+    if (!cursor.peek('[')) {
+        return cursor.skipValue();
+    }
+    cursor.consume('[');
+    if (cursor.consume(']')) {
+        return true;
+    }
+
+    do {
+        if (batch.count == GameActionBatchPayload::MAX_ACTIONS || !cursor.consume('{')) {
+            return false;
+        }
+        GameActionPayload& action = batch.actions[batch.count++];
+        if (cursor.consume('}')) {
+            continue;
+        }
+        do {
+            std::string_view key;
+            if (!cursor.readString(key) || !cursor.consume(':')) {
+                return false;
+            }
+            if (!parseActionField(cursor, lookup(FIELDS, key, Field::Unknown), action)) {
+                return false;
+            }
+        } while (cursor.consume(','));
+        if (!cursor.consume('}')) {
+            return false;
+        }
+    } while (cursor.consume(','));
+
+    return cursor.consume(']');
+}
+
+} // namespace
+
+std::string_view actionTypeName(ActionType type) {
+    switch (type) {
+        case ActionType::Spawn: return "spawn";
+        case ActionType::Despawn: return "despawn";
+        case ActionType::Move: return "move";
+        case ActionType::Shoot: return "shoot";
+        default: return "unknown";
+    }
+}
+
+bool parseClientMessage(char* data, size_t length, ClientMessage& message) {
+    Cursor cursor(data, length);
+
+    if (!cursor.consume('{')) {
+        return false;
+    }
+
+    if (!cursor.consume('}')) {
+        do {
+            std::string_view key;
+            if (!cursor.readString(key) || !cursor.consume(':')) {
+                return false;
+            }
+
+            bool ok;
+            Field field = lookup(FIELDS, key, Field::Unknown);
+            switch (field) {
+                case Field::Type: ok = cursor.readStringField(message.typeName); break;
+                case Field::GameMode: ok = cursor.readStringField(message.matchmaking.gameMode); break;
+                case Field::MinPlayers: ok = cursor.readNumberField(message.matchmaking.minPlayers); break;
+                case Field::MaxPlayers: ok = cursor.readNumberField(message.matchmaking.maxPlayers); break;
+                case Field::Message: ok = cursor.readStringField(message.chat.message); break;
+                case Field::Channel: ok = cursor.readStringField(message.chat.channel); break;
+                case Field::Latency: ok = cursor.readNumberField(message.ping.latency); break;
+                case Field::Token: ok = cursor.readStringField(message.resume.token); break;
+                case Field::LastTick: ok = cursor.readNumberField(message.resume.lastTick); break;
+                case Field::Actions: ok = parseActionBatch(cursor, message.batch); break;
+                case Field::Unknown: ok = cursor.skipValue(); break;
+                default: ok = parseActionField(cursor, field, message.action); break;
+            }
+            if (!ok) {
+                return false;
+            }
+        } while (cursor.consume(','));
+
+        if (!cursor.consume('}')) {
+            return false;
+        }
+    }
+
+    if (!cursor.atEnd()) {
+        return false;
+    }
+
+    message.type = lookupMessageType(message.typeName);
+    message.action.actionType = lookupActionType(message.action.actionName);
+    for (size_t i = 0; i < message.batch.count; ++i) {
+        GameActionPayload& action = message.batch.actions[i];
+        action.actionType = lookupActionType(action.actionName);
+        if (action.clientTick == 0) {
+            action.clientTick = message.action.clientTick;
+        }
+    }
+    return true;
+}
+
+} // namespace MessageParser
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+// Ingress parser for client JSON messages on the "game-websocket" protocol
+// (and the JSON side of "game-binary").
+//
+// Frames are parsed in situ from the receive buffer in a single pass: no DOM is
+// built and nothing is allocated. String fields are views into the frame; escape
+// sequences are decoded in place (the result is never longer than the source),
+// so the buffer must be writable and outlive the parsed message. Message types,
+// action types and field names are matched through compile-time tables.
+namespace MessageParser {
+
+enum class MessageType : uint8_t {
+    Unknown,
+    MatchmakingRequest,
+    ChatMessage,
+    GameAction,
+    Ping,
+    Resume,
+    GameActions
+};
+
+enum class ActionType : uint8_t {
+    Unknown,
+    Spawn,
+    Despawn, // Server-internal, never accepted from clients
+    Move,
+    Shoot
+};
+
+struct MatchmakingPayload {
+    std::string_view gameMode = "default";
+    int minPlayers = 2;
+    int maxPlayers = 4;
+};
+
+struct ChatPayload {
+    std::string_view message;
+    std::string_view channel = "global";
+};
+
+struct GameActionPayload {
+    ActionType actionType = ActionType::Unknown;
+    std::string_view actionName; // As sent, for logging unknown actions
+    uint64_t actionId = 0;
+    uint64_t timestamp = 0;
+    bool hasTimestamp = false;
+    uint64_t sequenceNumber = 0;
+    uint64_t clientTick = 0; // Latest server tick the client had seen when it acted; 0 = unknown
+    int32_t dx = 0; // data.dx
+    int32_t dy = 0; // data.dy
+};
+
+// game_actions: the client's inputs since its last batch, preceded by a few it
+// already sent (resends are dropped by sequence number)
+struct GameActionBatchPayload {
+    static constexpr size_t MAX_ACTIONS = 16; // Larger batches are rejected as malformed
+    GameActionPayload actions[MAX_ACTIONS];
+    size_t count = 0;
+};
+
+struct PingPayload {
+    double latency = -1; // Client's last measured round trip in ms; negative = not reported
+};
+
+struct ResumePayload {
+    std::string_view token; // reconnectToken from the previous connection
+    uint64_t lastTick = 0;  // Last state the client applied; 0 = none, send a full state
+};
+
+// Only the payload matching type is meaningful
+struct ClientMessage {
+    MessageType type = MessageType::Unknown;
+    std::string_view typeName;
+    MatchmakingPayload matchmaking;
+    ChatPayload chat;
+    GameActionPayload action; // Its tick is also the default for batched actions without one
+    GameActionBatchPayload batch;
+    PingPayload ping;
+    ResumePayload resume;
+};
+
+// FNV-1a, used to intern names at compile time
+constexpr uint32_t hashName(std::string_view name) {
+    uint32_t hash = 2166136261u;
+    for (char c : name) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+    }
+    return hash;
+}
+
+template <typename Id>
+struct NameEntry {
+    std::string_view name;
+    Id id;
+    uint32_t hash;
+};
+
+template <typename Id>
+constexpr NameEntry<Id> entry(std::string_view name, Id id) {
+    return NameEntry<Id>{name, id, hashName(name)};
+}
+
+constexpr NameEntry<MessageType> MESSAGE_TYPES[] = {
+    entry("matchmaking_request", MessageType::MatchmakingRequest),
+    entry("chat_message", MessageType::ChatMessage),
+    entry("game_action", MessageType::GameAction),
+    entry("ping", MessageType::Ping),
+    entry("resume", MessageType::Resume),
+    entry("game_actions", MessageType::GameActions)
+};
+
+constexpr NameEntry<ActionType> ACTION_TYPES[] = {
+    entry("spawn", ActionType::Spawn),
+    entry("move", ActionType::Move),
+    entry("shoot", ActionType::Shoot)
+};
+
+template <typename Id, size_t N>
+constexpr Id lookup(const NameEntry<Id> (&table)[N], std::string_view name, Id fallback) {
+    uint32_t hash = hashName(name);
+    for (const auto& e : table) {
+        if (e.hash == hash && e.name == name) {
+            return e.id;
+        }
+    }
+    return fallback;
+}
+
+constexpr MessageType lookupMessageType(std::string_view name) {
+    return lookup(MESSAGE_TYPES, name, MessageType::Unknown);
+}
+
+constexpr ActionType lookupActionType(std::string_view name) {
+    return lookup(ACTION_TYPES, name, ActionType::Unknown);
+}
+
+static_assert(lookupMessageType("game_action") == MessageType::GameAction, "message type table");
+static_assert(lookupActionType("move") == ActionType::Move, "action type table");
+
+std::string_view actionTypeName(ActionType type);
+
+// Parses one JSON object frame. Returns false on malformed input; type is
+// Unknown if the frame parsed but its type is not recognised.
+bool parseClientMessage(char* data, size_t length, ClientMessage& message);
+
+} // namespace MessageParser
@@ -0,0 +1,126 @@
+#include "Metrics.h"
+#include <cstdio>
+
+namespace Metrics {
+
+constexpr uint64_t Histogram::BOUNDS_US[];
+
+size_t threadShard() {
+    static std::atomic<size_t> nextShard{0};
+    static thread_local size_t shard = nextShard.fetch_add(1, std::memory_order_relaxed) % SHARD_COUNT;
+    return shard;
+}
+
+uint64_t Counter::value() const {
+    uint64_t total = 0;
+    for (const Slot& slot : m_slots) {
+        total += slot.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void Histogram::observe(uint64_t micros) {
+    size_t bucket = 0;
+    while (bucket < BUCKET_COUNT - 1 && micros > BOUNDS_US[bucket]) {
+        ++bucket;
+    }
+    Slot& slot = m_slots[threadShard()];
+    slot.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    slot.sumUs.fetch_add(micros, std::memory_order_relaxed);
+}
+
+Histogram::Totals Histogram::totals() const {
+    // Shards are read one at a time, so a scrape racing an update may be off by that update
+    Totals totals;
+    for (const Slot& slot : m_slots) {
+        for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+            uint64_t n = slot.buckets[i].load(std::memory_order_relaxed);
+            totals.buckets[i] += n;
+            totals.count += n;
+        }
+        totals.sumUs += slot.sumUs.load(std::memory_order_relaxed);
+    }
+    return totals;
+}
+
+std::string TextWriter::label(const char* name, const std::string& value) {
+    std::string out = name;
+    out += "=\"";
+    for (char c : value) {
+        switch (c) {
+            case '\\': out += "\\\\"; break;
+            case '"': out += "\\\""; break;
+            case '\n': out += "\\n"; break;
+            default: out += c;
+        }
+    }
+    out += '"';
+    return out;
+}
+
+void TextWriter::header(const char* name, const char* type, const char* help) {
+    m_out += "# HELP ";
+    m_out += name;
+    m_out += ' ';
+    m_out += help;
+    m_out += "\n# TYPE ";
+    m_out += name;
+    m_out += ' ';
+    m_out += type;
+    m_out += '\n';
+}
+
+void TextWriter::sample(const char* name, uint64_t value, const std::string& labels) {
+    writeName(name, "", labels);
+    m_out += std::to_string(value);
+    m_out += '\n';
+}
+
+void TextWriter::sample(const char* name, double value, const std::string& labels) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.9g", value);
+    writeName(name, "", labels);
+    m_out += buffer;
+    m_out += '\n';
+}
+
+void TextWriter::histogram(const char* name, const Histogram& histogram, const std::string& labels) {
+    Histogram::Totals totals = histogram.totals();
+    std::string prefix = labels.empty() ? "" : labels + ",";
+
+    uint64_t cumulative = 0;
+    char le[32];
+    for (size_t i = 0; i < Histogram::BUCKET_COUNT; ++i) {
+        cumulative += totals.buckets[i];
+        if (i < Histogram::BUCKET_COUNT - 1) {
+            std::snprintf(le, sizeof(le), "%g", Histogram::BOUNDS_US[i] / 1e6);
+        } else {
+            std::snprintf(le, sizeof(le), "+Inf");
+        }
+        writeName(name, "_bucket", prefix + "le=\"" + le + "\"");
+        m_out += std::to_string(cumulative);
+        m_out += '\n';
+    }
+
+    char sum[32];
+    std::snprintf(sum, sizeof(sum), "%.9g", totals.sumUs / 1e6);
+    writeName(name, "_sum", labels);
+    m_out += sum;
+    m_out += '\n';
+    writeName(name, "_count", labels);
+    m_out += std::to_string(totals.count);
+    m_out += '\n';
+}
+
+void TextWriter::writeName(const char* name, const char* suffix, const std::string& labels) {
+    m_out += name;
+    m_out += suffix;
+    if (!labels.empty()) {
+        m_out += '{';
+        m_out += labels;
+        m_out += '}';
+    }
+    m_out += ' ';
+}
+
+} // namespace Metrics
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Counters and histograms for the /metrics endpoint (Prometheus text format).
+//
+// Updates never lock and never contend: every metric keeps one cache-line sized
+// slot per shard and a thread writes only the slot of its own shard (threads are
+// given shards round robin on first use). Scrapes sum the shards, so reading is
+// O(shards) and happens off the hot path. Gauges such as queue depths are not
+// stored at all; they are sampled from their owners at scrape time.
+namespace Metrics {
+
+constexpr size_t SHARD_COUNT = 16;
+
+size_t threadShard(); // This thread's shard, fixed for its lifetime
+
+class Counter {
+public:
+    void add(uint64_t n = 1) {
+        m_slots[threadShard()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const;
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> value{0};
+    };
+    Slot m_slots[SHARD_COUNT];
+};
+
+// Durations in microseconds, exported in seconds
+class Histogram {
+public:
+    static constexpr uint64_t BOUNDS_US[] = {10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000};
+    static constexpr size_t BUCKET_COUNT = sizeof(BOUNDS_US) / sizeof(BOUNDS_US[0]) + 1; // Last is +Inf
+
+    void observe(uint64_t micros);
+
+    struct Totals {
+        uint64_t buckets[BUCKET_COUNT] = {}; // Not cumulative
+        uint64_t count = 0;
+        uint64_t sumUs = 0;
+    };
+    Totals totals() const;
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> buckets[BUCKET_COUNT] = {};
+        std::atomic<uint64_t> sumUs{0};
+    };
+    Slot m_slots[SHARD_COUNT];
+};
+
+// Tick phase timings and lag compensation counters, shared by every world so they
+// outlive the matches that produce them
+struct TickMetrics {
+    Histogram processActions;
+    Histogram simulate;
+    Histogram broadcast;
+    Histogram snapshot;
+    Counter rewinds;
+    Counter resimulatedTicks;
+    Counter droppedActions;
+};
+
+// Builds a scrape response. Families are declared once with header(), followed by
+// their samples; labels are given preformatted, e.g. "phase=\"simulate\"". Values
+// that come from outside the server must go through label(), which escapes them.
+class TextWriter {
+public:
+    static std::string label(const char* name, const std::string& value); // name="value", escaped
+    void header(const char* name, const char* type, const char* help);
+    void sample(const char* name, uint64_t value, const std::string& labels = "");
+    void sample(const char* name, double value, const std::string& labels = "");
+    void histogram(const char* name, const Histogram& histogram, const std::string& labels = "");
+
+    const std::string& str() const { return m_out; }
+
+private:
+    std::string m_out;
+
+    void writeName(const char* name, const char* suffix, const std::string& labels);
+};
+
+} // namespace Metrics
@@ -1,99 +1,177 @@
 #include "PlayerManager.h"
-#include <algorithm>
+#include "Rcu.h"
 
-PlayerManager::PlayerManager() : m_nextPlayerId(1) {
+namespace {
+const int DEFAULT_RATING = 1500;
+}
+
+PlayerManager::PlayerManager() : m_slotCount(0), m_playerCount(0) {
+    for (auto& chunk : m_chunks) {
+        chunk.store(nullptr, std::memory_order_relaxed);
+    }
 }
 
 PlayerManager::~PlayerManager() {
+    for (auto& chunk : m_chunks) {
+        Slot* slots = chunk.load(std::memory_order_relaxed);
+        if (!slots) {
+            continue;
+        }
+        for (uint32_t i = 0; i < CHUNK_SIZE; ++i) {
+            delete slots[i].player.load(std::memory_order_relaxed);
+        }
+        delete[] slots;
+    }
 }
 
-void PlayerManager::addPlayer(uint64_t playerId) {
-    std::lock_guard<std::mutex> lock(m_mutex);
+uint64_t PlayerManager::addPlayer() {
+    std::lock_guard<std::mutex> lock(m_allocMutex);
+    
+    uint32_t index;
+    if (!m_freeSlots.empty()) {
+        index = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    } else {
+        if (m_slotCount == MAX_CHUNKS * CHUNK_SIZE) {
+            return 0;
+        }
+        index = m_slotCount++;
+        std::atomic<Slot*>& chunk = m_chunks[index >> CHUNK_BITS];
+        if (!chunk.load(std::memory_order_relaxed)) {
+            chunk.store(new Slot[CHUNK_SIZE], std::memory_order_release);
+        }
+    }
+    
+    Slot& slot = m_chunks[index >> CHUNK_BITS].load(std::memory_order_relaxed)[index & (CHUNK_SIZE - 1)];
+    uint32_t generation = slot.nextGeneration++;
+    uint64_t playerId = (static_cast<uint64_t>(generation) << 32) | index;
     
-    Player player;
-    player.id = playerId;
-    player.username = "Player" + std::to_string(playerId);
-    player.inMatch = false;
-    player.currentMatchId = "";
-    player.lastPingTime = 0;
-    player.latency = 0.0f;
+    auto player = std::make_shared<Player>();
+    player->id = playerId;
+    player->username = "Player" + std::to_string(playerId);
+    player->inMatch = false;
+    player->currentMatchId = "";
+    player->lastPingTime = 0;
+    player->latency = 0.0f;
+    player->rating = DEFAULT_RATING;
     
-    m_players[playerId] = player;
+    slot.player.store(new PlayerSnapshot(std::move(player)), std::memory_order_release);
+    slot.generation.store(generation, std::memory_order_release);
+    m_playerCount.fetch_add(1, std::memory_order_relaxed);
+    return playerId;
 }
 
-void PlayerManager::removePlayer(uint64_t playerId) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    m_players.erase(playerId);
+bool PlayerManager::removePlayer(uint64_t playerId) {
+    std::lock_guard<std::mutex> lock(m_allocMutex);
+    
+    Slot* slot = findSlot(playerId);
+    if (!slot || generationOf(playerId) == 0 || slot->generation.load(std::memory_order_relaxed) != generationOf(playerId)) {
+        return false;
+    }
+    
+    // Readers still holding the snapshot keep it; new lookups of this ID fail from here on
+    slot->generation.store(0, std::memory_order_release);
+    Rcu::retire(slot->player.exchange(nullptr, std::memory_order_acq_rel));
+    
+    // Reusing a slot past its last generation would make old IDs resolve again
+    if (slot->nextGeneration < GENERATION_LIMIT) {
+        m_freeSlots.push_back(indexOf(playerId));
+    }
+    m_playerCount.fetch_sub(1, std::memory_order_relaxed);
+    return true;
 }
 
 bool PlayerManager::playerExists(uint64_t playerId) const {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    return m_players.find(playerId) != m_players.end();
+    const Slot* slot = findSlot(playerId);
+    return slot && generationOf(playerId) != 0 && slot->generation.load(std::memory_order_acquire) == generationOf(playerId);
 }
 
-Player* PlayerManager::getPlayer(uint64_t playerId) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    auto it = m_players.find(playerId);
-    if (it != m_players.end()) {
-        return &it->second;
+PlayerManager::PlayerSnapshot PlayerManager::getPlayer(uint64_t playerId) const {
+    const Slot* slot = findSlot(playerId);
+    if (!slot) {
+        return nullptr;
     }
-    return nullptr;
+    Rcu::ReadGuard guard;
+    const PlayerSnapshot* player = slot->player.load(std::memory_order_acquire);
+    return (player && (*player)->id == playerId) ? *player : nullptr;
 }
 
-const Player* PlayerManager::getPlayer(uint64_t playerId) const {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    auto it = m_players.find(playerId);
-    if (it != m_players.end()) {
-        return &it->second;
+const PlayerManager::Slot* PlayerManager::findSlot(uint64_t playerId) const {
+    uint32_t index = indexOf(playerId);
+    if ((index >> CHUNK_BITS) >= MAX_CHUNKS) {
+        return nullptr;
     }
-    return nullptr;
+    const Slot* chunk = m_chunks[index >> CHUNK_BITS].load(std::memory_order_acquire);
+    return chunk ? &chunk[index & (CHUNK_SIZE - 1)] : nullptr;
 }
 
-void PlayerManager::setPlayerUsername(uint64_t playerId, const std::string& username) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    auto it = m_players.find(playerId);
-    if (it != m_players.end()) {
-        it->second.username = username;
+PlayerManager::Slot* PlayerManager::findSlot(uint64_t playerId) {
+    return const_cast<Slot*>(static_cast<const PlayerManager*>(this)->findSlot(playerId));
+}
+
+template <typename Fn>
+void PlayerManager::update(uint64_t playerId, Fn&& fn) {
+    Slot* slot = findSlot(playerId);
+    if (!slot) {
+        return;
+    }
+    
+    Rcu::ReadGuard guard;
+    const PlayerSnapshot* current = slot->player.load(std::memory_order_acquire);
+    while (current && (*current)->id == playerId) {
+        auto copy = std::make_shared<Player>(**current);
+        fn(*copy);
+        auto next = new PlayerSnapshot(std::move(copy));
+        if (slot->player.compare_exchange_weak(current, next, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            Rcu::retire(current);
+            return;
+        }
+        delete next;
     }
 }
 
+void PlayerManager::setPlayerUsername(uint64_t playerId, const std::string& username) {
+    update(playerId, [&](Player& player) { player.username = username; });
+}
+
 void PlayerManager::setPlayerInMatch(uint64_t playerId, bool inMatch, const std::string& matchId) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    auto it = m_players.find(playerId);
-    if (it != m_players.end()) {
-        it->second.inMatch = inMatch;
-        it->second.currentMatchId = matchId;
-    }
+    update(playerId, [&](Player& player) {
+        player.inMatch = inMatch;
+        player.currentMatchId = matchId;
+    });
 }
 
 void PlayerManager::updatePlayerLatency(uint64_t playerId, float latency) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    auto it = m_players.find(playerId);
-    if (it != m_players.end()) {
-        it->second.latency = latency;
-    }
+    update(playerId, [&](Player& player) { player.latency = latency; });
+}
+
+void PlayerManager::setPlayerRating(uint64_t playerId, int rating) {
+    update(playerId, [&](Player& player) { player.rating = rating; });
 }
 
 void PlayerManager::updatePlayerPing(uint64_t playerId, uint64_t timestamp) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    auto it = m_players.find(playerId);
-    if (it != m_players.end()) {
-        it->second.lastPingTime = timestamp;
-    }
+    update(playerId, [&](Player& player) { player.lastPingTime = timestamp; });
 }
 
 size_t PlayerManager::getPlayerCount() const {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    return m_players.size();
+    return m_playerCount.load(std::memory_order_relaxed);
 }
 
 std::vector<uint64_t> PlayerManager::getAllPlayerIds() const {
-    std::lock_guard<std::mutex> lock(m_mutex);
     std::vector<uint64_t> ids;
-    ids.reserve(m_players.size());
-    for (const auto& pair : m_players) {
-        ids.push_back(pair.first);
+    ids.reserve(getPlayerCount());
+    Rcu::ReadGuard guard;
+    for (const auto& chunk : m_chunks) {
+        const Slot* slots = chunk.load(std::memory_order_acquire);
+        if (!slots) {
+            break; // Chunks are allocated in order
+        }
+        for (uint32_t i = 0; i < CHUNK_SIZE; ++i) {
+            const PlayerSnapshot* player = slots[i].player.load(std::memory_order_acquire);
+            if (player) {
+                ids.push_back((*player)->id);
+            }
+        }
     }
     return ids;
 }
-
@@ -1,6 +1,8 @@
 #pragma once
 
-#include <unordered_map>
+#include <array>
+#include <atomic>
+#include <memory>
 #include <string>
 #include <vector>
 #include <mutex>
@@ -12,32 +14,68 @@ struct Player {
     bool inMatch;
     std::string currentMatchId;
     uint64_t lastPingTime;
-    float latency; // in milliseconds
+    float latency; // in milliseconds, round trip as reported by the client's pings
+    int rating;    // Matchmaking skill rating
 };
 
+// Generational slot map of players. A player ID is its handle: the slot index in
+// the low 32 bits and the slot's generation above it. Removing a player bumps the
+// generation, so an ID held past disconnect never resolves again, even once the
+// slot is reused. Generations stay below 2^21 to keep IDs exact in JavaScript; a
+// slot whose generation would wrap is retired instead of reused.
+//
+// Slots live in fixed-size chunks that never move, so a lookup is two array
+// indexes. Each slot publishes an immutable Player snapshot through an atomic
+// pointer (RCU style, as in ClientRegistry): readers load it inside an
+// Rcu::ReadGuard without taking any lock and may keep it after the player is
+// removed; updates copy the snapshot, swap it in with compare-and-swap and retire
+// the old one. Only adding and removing players takes a lock.
 class PlayerManager {
 public:
+    using PlayerSnapshot = std::shared_ptr<const Player>;
+    
     PlayerManager();
     ~PlayerManager();
     
-    void addPlayer(uint64_t playerId);
-    void removePlayer(uint64_t playerId);
-    bool playerExists(uint64_t playerId) const;
+    uint64_t addPlayer(); // Returns the new player's ID, or 0 if every slot is taken
+    bool removePlayer(uint64_t playerId);
+    bool playerExists(uint64_t playerId) const; // Generation check only, no snapshot is loaded
     
-    Player* getPlayer(uint64_t playerId);
-    const Player* getPlayer(uint64_t playerId) const;
+    PlayerSnapshot getPlayer(uint64_t playerId) const; // nullptr if the ID is stale or unknown
     
     void setPlayerUsername(uint64_t playerId, const std::string& username);
     void setPlayerInMatch(uint64_t playerId, bool inMatch, const std::string& matchId = "");
     void updatePlayerLatency(uint64_t playerId, float latency);
+    void setPlayerRating(uint64_t playerId, int rating);
     void updatePlayerPing(uint64_t playerId, uint64_t timestamp);
     
     size_t getPlayerCount() const;
     std::vector<uint64_t> getAllPlayerIds() const;
-    
+
 private:
-    std::unordered_map<uint64_t, Player> m_players;
-    mutable std::mutex m_mutex;
-    uint64_t m_nextPlayerId;
+    static constexpr uint32_t CHUNK_BITS = 10;
+    static constexpr uint32_t CHUNK_SIZE = 1u << CHUNK_BITS;
+    static constexpr uint32_t MAX_CHUNKS = 4096; // Up to 4M concurrent players
+    static constexpr uint32_t GENERATION_LIMIT = 1u << 21;
+    
+    struct Slot {
+        std::atomic<const PlayerSnapshot*> player{nullptr}; // nullptr while free; retired through Rcu
+        std::atomic<uint32_t> generation{0};                // Of the current occupant, 0 while free; written under m_allocMutex
+        uint32_t nextGeneration = 1;                        // Guarded by m_allocMutex; GENERATION_LIMIT = retired
+    };
+    
+    std::array<std::atomic<Slot*>, MAX_CHUNKS> m_chunks;
+    std::vector<uint32_t> m_freeSlots;
+    uint32_t m_slotCount;
+    std::atomic<size_t> m_playerCount;
+    std::mutex m_allocMutex;
+    
+    static uint32_t indexOf(uint64_t playerId) { return static_cast<uint32_t>(playerId); }
+    static uint32_t generationOf(uint64_t playerId) { return static_cast<uint32_t>(playerId >> 32); }
+    const Slot* findSlot(uint64_t playerId) const; // nullptr if the index was never allocated
+    Slot* findSlot(uint64_t playerId);
+    
+    // Copies the player's snapshot, applies fn, and publishes the copy; retries if another update won
+    template <typename Fn>
+    void update(uint64_t playerId, Fn&& fn);
 };
-
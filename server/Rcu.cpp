@@ -0,0 +1,147 @@
+#include "Rcu.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+namespace Rcu {
+
+namespace {
+
+struct ThreadRecord {
+    std::atomic<uint64_t> epoch{0}; // Announced while inside a guard, 0 outside
+    uint32_t depth = 0;             // Nested guards; owning thread only
+    std::atomic<bool> exited{false};
+};
+
+struct Retired {
+    void* object;
+    void (*destroy)(void*);
+    uint64_t epoch;
+};
+
+struct Domain {
+    std::atomic<uint64_t> epoch{1};
+    std::mutex mutex; // Guards threads and retired
+    std::vector<std::shared_ptr<ThreadRecord>> threads;
+    std::vector<Retired> retired;
+
+    ~Domain() {
+        // Static destruction: every thread has left its guards
+        for (const Retired& entry : retired) {
+            entry.destroy(entry.object);
+        }
+    }
+};
+
+Domain& domain() {
+    static Domain instance;
+    return instance;
+}
+
+struct ThreadHolder {
+    std::shared_ptr<ThreadRecord> record;
+
+    ~ThreadHolder() {
+        if (record) {
+            record->exited.store(true, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadHolder t_holder;
+
+ThreadRecord& threadRecord() {
+    if (!t_holder.record) {
+        Domain& d = domain();
+        t_holder.record = std::make_shared<ThreadRecord>();
+        std::lock_guard<std::mutex> lock(d.mutex);
+        d.threads.push_back(t_holder.record);
+    }
+    return *t_holder.record;
+}
+
+// Advances the epoch if every reader has caught up and moves whatever no reader can
+// still hold into freed. Caller holds d.mutex.
+void collectLocked(Domain& d, std::vector<Retired>& freed) {
+    uint64_t epoch = d.epoch.load(std::memory_order_relaxed);
+    bool caughtUp = true;
+    for (const auto& thread : d.threads) {
+        uint64_t announced = thread->epoch.load(std::memory_order_seq_cst);
+        if (announced != 0 && announced != epoch) {
+            caughtUp = false;
+            break;
+        }
+    }
+    if (caughtUp) {
+        d.epoch.store(++epoch, std::memory_order_seq_cst);
+    }
+
+    // Exited threads are outside any guard
+    d.threads.erase(std::remove_if(d.threads.begin(), d.threads.end(),
+                                   [](const std::shared_ptr<ThreadRecord>& thread) {
+                                       return thread->exited.load(std::memory_order_acquire);
+                                   }),
+                    d.threads.end());
+
+    auto reclaimable = std::partition(d.retired.begin(), d.retired.end(),
+                                      [epoch](const Retired& entry) { return entry.epoch + 2 > epoch; });
+    freed.assign(reclaimable, d.retired.end());
+    d.retired.erase(reclaimable, d.retired.end());
+}
+
+} // namespace
+
+ReadGuard::ReadGuard() {
+    ThreadRecord& record = threadRecord();
+    if (record.depth++ > 0) {
+        return;
+    }
+
+    // Announce, then make sure the epoch did not move before the announcement was
+    // visible; the fence keeps the caller's pointer loads after it
+    Domain& d = domain();
+    uint64_t epoch = d.epoch.load(std::memory_order_relaxed);
+    for (;;) {
+        record.epoch.store(epoch, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t current = d.epoch.load(std::memory_order_relaxed);
+        if (current == epoch) {
+            break;
+        }
+        epoch = current;
+    }
+}
+
+ReadGuard::~ReadGuard() {
+    ThreadRecord& record = *t_holder.record;
+    if (--record.depth == 0) {
+        record.epoch.store(0, std::memory_order_release);
+    }
+}
+
+void retire(void* object, void (*destroy)(void*)) {
+    // The caller's unlink must be visible before the retire epoch is read
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    Domain& d = domain();
+    std::vector<Retired> freed;
+    {
+        std::lock_guard<std::mutex> lock(d.mutex);
+        d.retired.push_back(Retired{object, destroy, d.epoch.load(std::memory_order_relaxed)});
+        collectLocked(d, freed);
+    }
+    for (const Retired& entry : freed) {
+        entry.destroy(entry.object);
+    }
+}
+
+size_t pendingCount() {
+    Domain& d = domain();
+    std::lock_guard<std::mutex> lock(d.mutex);
+    return d.retired.size();
+}
+
+} // namespace Rcu
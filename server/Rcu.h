@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+
+// Epoch-based reclamation for read-mostly structures published through atomic raw
+// pointers (ClientRegistry shards, PlayerManager slots). A reader brackets its
+// accesses with a ReadGuard, which only publishes the current epoch in the calling
+// thread's record: no lock and no read-modify-write on shared state, so lookups
+// never wait on writers or on each other. A writer swaps in a new object and
+// retire()s the old one, which is destroyed once every reader that could still
+// see it has left its guard.
+//
+// The epoch advances when every thread inside a guard has announced the current
+// one; an object retired in epoch E is destroyed once the epoch reaches E + 2.
+// Collection runs on retire(), so the last few retired objects wait for the next
+// write. A thread's first guard registers it (one lock, once per thread).
+namespace Rcu {
+
+class ReadGuard {
+public:
+    ReadGuard();
+    ~ReadGuard();
+
+    ReadGuard(const ReadGuard&) = delete;
+    ReadGuard& operator=(const ReadGuard&) = delete;
+};
+
+// Hands object to destroy once no reader can hold it. Writers only; takes a short lock.
+void retire(void* object, void (*destroy)(void*));
+
+template <typename T>
+void retire(const T* object) {
+    retire(const_cast<T*>(object), [](void* p) { delete static_cast<T*>(p); });
+}
+
+size_t pendingCount(); // Retired objects not destroyed yet
+
+} // namespace Rcu
@@ -0,0 +1,152 @@
+#include "StateCodec.h"
+
+namespace {
+
+void writeVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void writeZigzag(std::string& out, int64_t value) {
+    writeVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+bool readVarint(std::string_view data, size_t& offset, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && offset < data.size(); shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(data[offset++]);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+namespace StateCodec {
+
+std::string encodeStateDelta(const EntityStore* baseState, const InterestGrid::Region& baseView,
+                             const EntityStore& state, const InterestGrid::Region& view,
+                             const std::vector<size_t>& visible,
+                             uint64_t tick, uint64_t serverTime, uint64_t baseTick) {
+    std::string upserts;
+    std::string projectileUpserts;
+    uint64_t upsertCount = 0;
+    uint64_t projectileUpsertCount = 0;
+    for (size_t i : visible) {
+        if (state.type(i) == EntityType::Projectile) {
+            EntityStore::Handle handle = state.handle(i);
+            if (baseState && baseState->isValid(handle)) {
+                size_t index = baseState->indexOf(handle);
+                if (baseState->type(index) == EntityType::Projectile && baseState->owner(index) == state.owner(i) &&
+                    baseState->x(index) == state.x(i) && baseState->y(index) == state.y(i) &&
+                    baseView.contains(state.x(i), state.y(i))) {
+                    continue;
+                }
+            }
+            writeVarint(projectileUpserts, handle);
+            writeVarint(projectileUpserts, state.owner(i));
+            writeZigzag(projectileUpserts, state.x(i));
+            writeZigzag(projectileUpserts, state.y(i));
+            projectileUpsertCount++;
+            continue;
+        }
+        uint64_t playerId = state.owner(i);
+        int32_t x = state.x(i);
+        int32_t y = state.y(i);
+
+        if (baseState) {
+            EntityStore::Handle before = baseState->findPlayer(playerId);
+            if (baseState->isValid(before)) {
+                size_t index = baseState->indexOf(before);
+                int32_t baseX = baseState->x(index);
+                int32_t baseY = baseState->y(index);
+                if (baseX == x && baseY == y && baseView.contains(baseX, baseY)) {
+                    continue; // Unchanged since the client's baseline
+                }
+            }
+        }
+
+        writeVarint(upserts, playerId);
+        writeZigzag(upserts, x);
+        writeZigzag(upserts, y);
+        upsertCount++;
+    }
+
+    std::string removals;
+    std::string projectileRemovals;
+    uint64_t removeCount = 0;
+    uint64_t projectileRemoveCount = 0;
+    if (baseState) {
+        for (size_t i = 0; i < baseState->size(); ++i) {
+            if (!baseView.contains(baseState->x(i), baseState->y(i))) {
+                continue; // The client never had it
+            }
+            if (baseState->type(i) == EntityType::Projectile) {
+                // Gone, reused by a player, or out of view; a reused projectile ID was upserted above
+                EntityStore::Handle handle = baseState->handle(i);
+                size_t index = state.isValid(handle) ? state.indexOf(handle) : 0;
+                if (!state.isValid(handle) || state.type(index) != EntityType::Projectile ||
+                    !view.contains(state.x(index), state.y(index))) {
+                    writeVarint(projectileRemovals, handle);
+                    projectileRemoveCount++;
+                }
+                continue;
+            }
+            uint64_t playerId = baseState->owner(i);
+            EntityStore::Handle now = state.findPlayer(playerId);
+            size_t index = state.isValid(now) ? state.indexOf(now) : 0;
+            if (!state.isValid(now) || !view.contains(state.x(index), state.y(index))) {
+                writeVarint(removals, playerId);
+                removeCount++;
+            }
+        }
+    }
+
+    std::string out;
+    out.reserve(32 + upserts.size() + removals.size() + projectileUpserts.size() + projectileRemovals.size());
+    out.push_back(static_cast<char>(STATE_DELTA));
+    writeVarint(out, tick);
+    writeVarint(out, serverTime);
+    writeVarint(out, baseState ? baseTick : 0);
+    writeVarint(out, upsertCount);
+    out += upserts;
+    writeVarint(out, removeCount);
+    out += removals;
+    writeVarint(out, projectileUpsertCount);
+    out += projectileUpserts;
+    writeVarint(out, projectileRemoveCount);
+    out += projectileRemovals;
+    return out;
+}
+
+bool decodeStateAck(std::string_view data, uint64_t& tick) {
+    if (data.empty() || static_cast<uint8_t>(data[0]) != STATE_ACK) {
+        return false;
+    }
+    size_t offset = 1;
+    return readVarint(data, offset, tick);
+}
+
+std::string encodeStateAck(uint64_t tick) {
+    std::string out;
+    out.push_back(static_cast<char>(STATE_ACK));
+    writeVarint(out, tick);
+    return out;
+}
+
+bool decodeStateDeltaHeader(std::string_view data, uint64_t& tick, uint64_t& serverTime, uint64_t& baseTick) {
+    if (data.empty() || static_cast<uint8_t>(data[0]) != STATE_DELTA) {
+        return false;
+    }
+    size_t offset = 1;
+    return readVarint(data, offset, tick) && readVarint(data, offset, serverTime) &&
+           readVarint(data, offset, baseTick);
+}
+
+} // namespace StateCodec
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "EntityStore.h"
+#include "InterestGrid.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+// Binary wire format for the "game-binary" WebSocket subprotocol.
+// All integers are LEB128 varints; signed coordinates are zigzag encoded.
+// Each client only receives entities inside its area of interest (see InterestGrid).
+// Players are keyed by player ID, projectiles by entity ID (the JSON "id"); entity
+// IDs are reused, so an upsert of a known ID replaces whatever the client held.
+//
+// State delta (server -> client):
+//   u8      kind = STATE_DELTA
+//   varint  tick
+//   varint  serverTime
+//   varint  baseTick      0 = full state, otherwise the acked tick this delta applies to
+//   varint  upsertCount   then per player: varint playerId, zigzag x, zigzag y
+//   varint  removeCount   then per player: varint playerId
+//   varint  projectileUpsertCount  then per projectile: varint id, varint ownerId, zigzag x, zigzag y
+//   varint  projectileRemoveCount  then per projectile: varint id
+//
+// State ack (client -> server):
+//   u8      kind = STATE_ACK
+//   varint  tick          last state the client has applied
+namespace StateCodec {
+
+enum MessageKind : uint8_t {
+    STATE_DELTA = 1,
+    STATE_ACK = 2
+};
+
+// Encodes the difference between baseState (nullptr = empty) and state as seen by
+// one client: baseView is the region it saw at baseTick, view the region it sees
+// now, and visible the dense indices of state inside view. Entities that left the
+// view are removed, entities that entered it are sent in full.
+std::string encodeStateDelta(const EntityStore* baseState, const InterestGrid::Region& baseView,
+                             const EntityStore& state, const InterestGrid::Region& view,
+                             const std::vector<size_t>& visible,
+                             uint64_t tick, uint64_t serverTime, uint64_t baseTick);
+
+bool decodeStateAck(std::string_view data, uint64_t& tick);
+
+// Client side, used by tools that speak the protocol (e.g. GameServerBench)
+std::string encodeStateAck(uint64_t tick);
+bool decodeStateDeltaHeader(std::string_view data, uint64_t& tick, uint64_t& serverTime, uint64_t& baseTick);
+
+} // namespace StateCodec
@@ -1,13 +1,14 @@
 #include "WebSocketServer.h"
+#include "Log.h"
 #include <libwebsockets.h>
-#include <iostream>
 #include <thread>
 #include <mutex>
-#include <unordered_map>
 #include <vector>
 #include <deque>
 #include <string>
 #include <cstring>
+#include <algorithm>
+#include <chrono>
 #include <new> // For placement new
 
 // Use the struct from the class
@@ -16,6 +17,14 @@ using PerSessionData = WebSocketServer::PerSessionData;
 // Global server instance (libwebsockets limitation)
 static WebSocketServer* g_serverInstance = nullptr;
 
+// Index of the lws service thread running on this thread, -1 elsewhere
+static thread_local int t_serviceThread = -1;
+
+static const size_t HTTP_CHUNK_SIZE = 4096;
+
+// Largest client message accepted; a full game_actions batch is well under this
+static const size_t MAX_INBOUND_MESSAGE_SIZE = 8192;
+
 static void ensure_session_initialized(PerSessionData* pss, const char* context) {
     if (pss && !pss->initialized) {
         new (pss) PerSessionData();
@@ -31,7 +40,7 @@ static int callback_websocket(struct lws *wsi, enum lws_callback_reasons reason,
             if (pss) ensure_session_initialized(pss, "WSI_CREATE");
             break;
         }
-
+        
         case LWS_CALLBACK_WSI_DESTROY: {
             if (pss && pss->initialized) {
                 pss->~PerSessionData();
@@ -42,15 +51,64 @@ static int callback_websocket(struct lws *wsi, enum lws_callback_reasons reason,
         
         case LWS_CALLBACK_HTTP: {
             if (pss) ensure_session_initialized(pss, "HTTP");
+            if (!pss || !g_serverInstance) return 0;
+            
+            // Only Prometheus scrapes are served over plain HTTP
+            const char* uri = (const char*)in;
+            if (!uri || strcmp(uri, "/metrics") != 0 || !g_serverInstance->renderMetrics(pss->httpBody)) {
+                if (lws_return_http_status(wsi, HTTP_STATUS_NOT_FOUND, nullptr)) return -1;
+                return lws_http_transaction_completed(wsi) ? -1 : 0;
+            }
+            
+            unsigned char headers[LWS_PRE + 256];
+            unsigned char* start = headers + LWS_PRE;
+            unsigned char* p = start;
+            unsigned char* end = headers + sizeof(headers) - 1;
+            if (lws_add_http_common_headers(wsi, HTTP_STATUS_OK, "text/plain; version=0.0.4; charset=utf-8",
+                                            pss->httpBody.size(), &p, end) ||
+                lws_finalize_write_http_header(wsi, start, &p, end)) {
+                return 1;
+            }
+            pss->httpSent = 0;
+            lws_callback_on_writable(wsi);
             return 0;
         }
         
+        case LWS_CALLBACK_HTTP_WRITEABLE: {
+            if (!pss || !pss->initialized) break;
+            
+            // The body goes out a chunk per writable callback
+            unsigned char chunk[LWS_PRE + HTTP_CHUNK_SIZE];
+            size_t remaining = pss->httpBody.size() - pss->httpSent;
+            size_t length = std::min(remaining, HTTP_CHUNK_SIZE);
+            bool last = (length == remaining);
+            memcpy(chunk + LWS_PRE, pss->httpBody.data() + pss->httpSent, length);
+            if (lws_write(wsi, chunk + LWS_PRE, length, last ? LWS_WRITE_HTTP_FINAL : LWS_WRITE_HTTP) != (int)length) {
+                return -1;
+            }
+            pss->httpSent += length;
+            
+            if (!last) {
+                lws_callback_on_writable(wsi);
+                break;
+            }
+            std::string().swap(pss->httpBody);
+            return lws_http_transaction_completed(wsi) ? -1 : 0;
+        }
+        
         case LWS_CALLBACK_ESTABLISHED: {
             if (!pss) return -1;
             ensure_session_initialized(pss, "ESTABLISHED");
             
-            if (g_serverInstance) {
-                g_serverInstance->onConnect(wsi);
+            // Clients that negotiated the binary subprotocol get delta-compressed state updates
+            WebSocketServer::Protocol sessionProtocol = WebSocketServer::Protocol::Json;
+            const struct lws_protocols* protocol = lws_get_protocol(wsi);
+            if (protocol && protocol->name && strcmp(protocol->name, "game-binary") == 0) {
+                sessionProtocol = WebSocketServer::Protocol::Binary;
+            }
+            
+            if (g_serverInstance && !g_serverInstance->onConnect(wsi, sessionProtocol)) {
+                return -1;
             }
             break;
         }
@@ -59,37 +117,46 @@ static int callback_websocket(struct lws *wsi, enum lws_callback_reasons reason,
             if (!pss) return -1;
             ensure_session_initialized(pss, "RECEIVE");
             
-            if (g_serverInstance && in && len > 0) {
-                std::string message((char*)in, len);
-                g_serverInstance->onMessage(wsi, message);
+            if (!g_serverInstance || !in) break;
+            
+            // Whole messages are dispatched straight from the lws receive buffer;
+            // only messages split across callbacks are copied for reassembly
+            char* data = (char*)in;
+            size_t length = len;
+            bool complete = lws_is_final_fragment(wsi) && lws_remaining_packet_payload(wsi) == 0;
+            if (pss->partialMessage.size() + len > MAX_INBOUND_MESSAGE_SIZE) {
+                LOG_WARN("WebSocket", "Closing client {}: message over {} bytes",
+                         pss->session ? pss->session->id.load(std::memory_order_relaxed) : 0, MAX_INBOUND_MESSAGE_SIZE);
+                const char* reason = "message too large";
+                lws_close_reason(wsi, LWS_CLOSE_STATUS_MESSAGE_TOO_LARGE, (unsigned char*)reason, strlen(reason));
+                return -1;
             }
+            if (!complete || !pss->partialMessage.empty()) {
+                pss->partialMessage.append(data, len);
+                if (!complete) break;
+                data = &pss->partialMessage[0];
+                length = pss->partialMessage.size();
+            }
+            
+            if (length > 0) {
+                if (lws_frame_is_binary(wsi)) {
+                    g_serverInstance->onBinaryMessage(wsi, data, length);
+                } else {
+                    g_serverInstance->onMessage(wsi, data, length);
+                }
+            }
+            pss->partialMessage.clear();
             break;
         }
         
         case LWS_CALLBACK_SERVER_WRITEABLE: {
-            if (!pss || !pss->initialized) break;
-            
-            std::string message;
-            bool hasMessage = false;
-            
-            try {
-                std::lock_guard<std::mutex> lock(pss->queueMutex);
-                if (!pss->writeQueue.empty()) {
-                    message = pss->writeQueue.front();
-                    pss->writeQueue.pop_front();
-                    hasMessage = true;
-                }
-            } catch (...) { return -1; }
-            
-            if (hasMessage) {
-                unsigned char* buf = new unsigned char[LWS_PRE + message.length()];
-                memcpy(&buf[LWS_PRE], message.c_str(), message.length());
-                int ret = lws_write(wsi, &buf[LWS_PRE], message.length(), LWS_WRITE_TEXT);
-                delete[] buf;
-                
-                if (ret < 0) return -1;
-                
-                lws_callback_on_writable(wsi); // Check if more needed
+            if (!pss || !pss->initialized || !pss->session || !g_serverInstance) break;
+            return g_serverInstance->onWritable(wsi, *pss->session);
+        }
+        
+        case LWS_CALLBACK_EVENT_WAIT_CANCELLED: {
+            if (g_serverInstance) {
+                g_serverInstance->onWakeup();
             }
             break;
         }
@@ -116,11 +183,31 @@ static struct lws_protocols protocols[] = {
         sizeof(PerSessionData),
         4096,
     },
+    {
+        "game-binary",
+        callback_websocket,
+        sizeof(PerSessionData),
+        4096,
+    },
     { nullptr, nullptr, 0, 0 }
 };
 
-WebSocketServer::WebSocketServer(int port) 
-    : m_port(port), m_running(false), context(nullptr), m_nextClientId(1) {
+WebSocketServer::OutboundBuffer::OutboundBuffer(const char* data, size_t length, bool binary, Delivery delivery)
+    : m_storage(data, data + length), m_binary(binary), m_delivery(delivery) {
+}
+
+WebSocketServer::SharedBuffer WebSocketServer::makeBuffer(const std::string& data, bool binary, Delivery delivery) {
+    return std::make_shared<const OutboundBuffer>(data.data(), data.size(), binary, delivery);
+}
+
+WebSocketServer::WebSocketServer(int port, int serviceThreads) 
+    : m_port(port), m_serviceThreadCount(serviceThreads < 1 ? 1 : serviceThreads),
+      m_stopping(false), context(nullptr), m_nextClientId(1), m_supersededFrames(0), m_evictions(0),
+      m_nextRoomHandle(LOBBY_ROOM + 1) {
+    m_roomHandles[""] = LOBBY_ROOM;
+    for (int i = 0; i < m_serviceThreadCount; ++i) {
+        m_serviceThreads.push_back(std::make_unique<ServiceThread>());
+    }
     g_serverInstance = this;
 }
 
@@ -138,26 +225,45 @@ void WebSocketServer::run() {
     info.uid = -1;
     info.options = LWS_SERVER_OPTION_VALIDATE_UTF8;
     info.pt_serv_buf_size = 4096;
+    info.count_threads = m_serviceThreadCount; // lws caps this at LWS_MAX_SMP
     
     context = lws_create_context(&info);
     if (!context) {
-        std::cerr << "Failed to create libwebsockets context" << std::endl;
+        LOG_ERROR("WebSocket", "Failed to create libwebsockets context");
         return;
     }
     
-    std::cout << "[WebSocketServer] Server started on port " << m_port << std::endl;
-    m_running = true;
+    LOG_INFO("WebSocket", "Server started on port {} with {} service threads", m_port, m_serviceThreadCount);
     
-    while (m_running && context) {
-        lws_service(context, 1); // 1ms poll for low latency
+    // lws spreads accepted connections across its per-thread service loops;
+    // the calling thread runs loop 0
+    for (int i = 1; i < m_serviceThreadCount; ++i) {
+        m_serviceThreads[i]->thread = std::thread(&WebSocketServer::serviceLoop, this, i);
+    }
+    serviceLoop(0);
+    
+    for (int i = 1; i < m_serviceThreadCount; ++i) {
+        if (m_serviceThreads[i]->thread.joinable()) {
+            m_serviceThreads[i]->thread.join();
+        }
     }
     
     lws_context_destroy(context);
     context = nullptr;
 }
 
+void WebSocketServer::serviceLoop(int threadIndex) {
+    t_serviceThread = threadIndex;
+    while (!m_stopping.load(std::memory_order_relaxed) && context) {
+        lws_service_tsi(context, 1, threadIndex); // 1ms poll for low latency
+    }
+    t_serviceThread = -1;
+}
+
 void WebSocketServer::stop() {
-    m_running = false;
+    // Called from signal handlers: a lock-free store is all that is allowed here
+    static_assert(std::atomic<bool>::is_always_lock_free, "stop() must stay async-signal-safe");
+    m_stopping.store(true, std::memory_order_relaxed);
 }
 
 void WebSocketServer::setOnConnect(ConnectCallback callback) {
@@ -172,102 +278,489 @@ void WebSocketServer::setOnMessage(MessageCallback callback) {
     m_onMessage = callback;
 }
 
-void WebSocketServer::onConnect(struct lws* wsi) {
-    std::lock_guard<std::recursive_mutex> lock(m_clientMapMutex);
-    uint64_t id = m_nextClientId++;
+void WebSocketServer::setOnMetrics(MetricsCallback callback) {
+    m_onMetrics = callback;
+}
+
+bool WebSocketServer::renderMetrics(std::string& body) {
+    if (!m_onMetrics) {
+        return false;
+    }
+    body = m_onMetrics();
+    return true;
+}
+
+void WebSocketServer::setIdAllocator(IdAllocator allocator) {
+    m_idAllocator = allocator;
+}
+
+void WebSocketServer::setOnBinaryMessage(MessageCallback callback) {
+    m_onBinaryMessage = callback;
+}
+
+bool WebSocketServer::onConnect(struct lws* wsi, Protocol protocol) {
+    PerSessionData* pss = (PerSessionData*)lws_wsi_user(wsi);
+    if (!pss) return false;
     
-    m_wsiToId[wsi] = id;
-    m_idToWsi[id] = wsi;
+    uint64_t id = m_idAllocator ? m_idAllocator() : m_nextClientId++;
+    if (id == 0) {
+        LOG_WARN("WebSocket", "Refusing connection: no client IDs left");
+        return false;
+    }
     
-    // Set ID in session data
-    PerSessionData* pss = (PerSessionData*)lws_wsi_user(wsi);
-    if (pss) pss->clientId = id;
+    auto session = std::make_shared<ClientSession>();
+    session->id.store(id, std::memory_order_relaxed);
+    session->protocol = protocol;
+    session->serviceThread = t_serviceThread < 0 ? 0 : t_serviceThread;
+    session->wsi = wsi;
+    pss->session = session;
+    m_clients.insert(id, session);
+    {
+        std::unique_lock<std::shared_mutex> lock(m_roomsMutex);
+        addToRoomLocked(session, LOBBY_ROOM);
+    }
     
-    std::cout << "[WebSocket] Client " << id << " connected" << std::endl;
+    LOG_INFO("WebSocket", "Client {} connected", id);
     
     if (m_onConnect) m_onConnect(id);
+    return true;
 }
 
 void WebSocketServer::onDisconnect(struct lws* wsi) {
-    std::lock_guard<std::recursive_mutex> lock(m_clientMapMutex);
-    auto it = m_wsiToId.find(wsi);
-    if (it != m_wsiToId.end()) {
-        uint64_t id = it->second;
-        m_wsiToId.erase(it);
-        m_idToWsi.erase(id);
-        
-        if (m_onDisconnect) m_onDisconnect(id);
+    PerSessionData* pss = (PerSessionData*)lws_wsi_user(wsi);
+    if (!pss || !pss->session) return;
+    
+    // Senders still holding the session see it closed and stop touching wsi
+    SessionPtr session = std::move(pss->session);
+    session->closed = true;
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(session->mutex);
+        id = session->id.load(std::memory_order_relaxed);
     }
+    // A session replaced by a resumed connection no longer owns its ID
+    bool owned = m_clients.erase(id, session);
+    {
+        std::unique_lock<std::shared_mutex> lock(m_roomsMutex);
+        while (!session->rooms.empty()) {
+            removeFromRoomLocked(session, session->rooms.back());
+        }
+    }
+    
+    if (owned && m_onDisconnect) m_onDisconnect(id);
+}
+
+void WebSocketServer::onMessage(struct lws* wsi, char* data, size_t length) {
+    m_framesIn.add();
+    m_bytesIn.add(length);
+    uint64_t id = getClientId(wsi);
+    if (id != 0 && m_onMessage) m_onMessage(id, data, length);
+}
+
+void WebSocketServer::onBinaryMessage(struct lws* wsi, char* data, size_t length) {
+    m_framesIn.add();
+    m_bytesIn.add(length);
+    uint64_t id = getClientId(wsi);
+    if (id != 0 && m_onBinaryMessage) m_onBinaryMessage(id, data, length);
 }
 
-void WebSocketServer::onMessage(struct lws* wsi, const std::string& message) {
-    std::lock_guard<std::recursive_mutex> lock(m_clientMapMutex);
-    auto it = m_wsiToId.find(wsi);
-    if (it != m_wsiToId.end()) {
-        if (m_onMessage) m_onMessage(it->second, message);
+void WebSocketServer::onWakeup() {
+    if (t_serviceThread < 0) {
+        return;
+    }
+    
+    std::vector<SessionPtr> pending;
+    {
+        ServiceThread& thread = *m_serviceThreads[t_serviceThread];
+        std::lock_guard<std::mutex> lock(thread.pendingMutex);
+        pending.swap(thread.pendingWritable);
+    }
+    
+    // Closing also happens on this thread, so a session not yet closed still has a live wsi
+    for (const SessionPtr& session : pending) {
+        if (!session->closed) {
+            lws_callback_on_writable(session->wsi);
+        }
     }
 }
 
-void WebSocketServer::send(uint64_t clientId, const std::string& message) {
-    std::lock_guard<std::recursive_mutex> lock(m_clientMapMutex);
-    auto it = m_idToWsi.find(clientId);
-    if (it != m_idToWsi.end()) {
-        struct lws* wsi = it->second;
-        PerSessionData* pss = (PerSessionData*)lws_wsi_user(wsi);
-        if (pss && pss->initialized) {
-            {
-                std::lock_guard<std::mutex> lock(pss->queueMutex);
-                pss->writeQueue.push_back(message);
+void WebSocketServer::requestWritable(const SessionPtr& session) {
+    if (t_serviceThread == session->serviceThread) {
+        if (!session->closed) {
+            lws_callback_on_writable(session->wsi);
+        }
+        return;
+    }
+    
+    bool wake;
+    {
+        ServiceThread& thread = *m_serviceThreads[session->serviceThread];
+        std::lock_guard<std::mutex> lock(thread.pendingMutex);
+        wake = thread.pendingWritable.empty(); // One wakeup per batch of parked sessions
+        thread.pendingWritable.push_back(session);
+    }
+    if (wake && context) {
+        lws_cancel_service(context);
+    }
+}
+
+void WebSocketServer::setOutboundLimits(const OutboundLimits& limits) {
+    m_limits = limits;
+}
+
+int WebSocketServer::onWritable(struct lws* wsi, ClientSession& session) {
+    std::vector<unsigned char>& scratch = m_serviceThreads[session.serviceThread]->writeScratch;
+    for (int written = 0; written < m_limits.maxFramesPerWrite; ++written) {
+        SharedBuffer message;
+        bool more;
+        {
+            std::lock_guard<std::mutex> lock(session.mutex);
+            if (session.evicting) {
+                const char* reason = session.closeReason ? session.closeReason : "";
+                lws_close_reason(wsi, LWS_CLOSE_STATUS_POLICY_VIOLATION, (unsigned char*)reason, strlen(reason));
+                return -1;
             }
-            lws_callback_on_writable(wsi);
+            if (session.writeQueue.empty()) {
+                return 0;
+            }
+            
+            message = std::move(session.writeQueue.front());
+            session.writeQueue.pop_front();
+            session.queuedBytes -= message->length();
+            if (message->delivery() == Delivery::LatestOnly) {
+                session.queuedLatestOnly--;
+            }
+            if (session.writeQueue.size() <= m_limits.maxQueuedMessages && session.queuedBytes <= m_limits.maxQueuedBytes) {
+                session.overLimitSince = 0; // Caught up; only eviction is decided on enqueue
+            }
+            more = !session.writeQueue.empty();
+        }
+        
+        // Other service threads may be writing the same shared buffer; lws puts the
+        // frame header in the headroom, so write from this thread's own copy
+        if (scratch.size() < LWS_PRE + message->length()) {
+            scratch.resize(LWS_PRE + message->length());
+        }
+        if (message->length() > 0) {
+            memcpy(scratch.data() + LWS_PRE, message->payload(), message->length());
+        }
+        int ret = lws_write(wsi, scratch.data() + LWS_PRE, message->length(),
+                            message->isBinary() ? LWS_WRITE_BINARY : LWS_WRITE_TEXT);
+        if (ret < 0) {
+            return -1;
+        }
+        m_framesOut.add();
+        m_bytesOut.add(message->length());
+        
+        // Keep going while the socket takes frames without lws buffering them
+        if (!more) {
+            return 0;
+        }
+        if (lws_send_pipe_choked(wsi)) {
+            break;
         }
     }
+    
+    lws_callback_on_writable(wsi); // The rest on the next writable callback
+    return 0;
 }
 
-void WebSocketServer::broadcast(const std::string& message) {
-    std::lock_guard<std::recursive_mutex> lock(m_clientMapMutex);
-    for (auto& pair : m_idToWsi) {
-        struct lws* wsi = pair.second;
-        PerSessionData* pss = (PerSessionData*)lws_wsi_user(wsi);
-        if (pss && pss->initialized) {
-            {
-                std::lock_guard<std::mutex> lock(pss->queueMutex);
-                pss->writeQueue.push_back(message);
+void WebSocketServer::checkLimitsLocked(ClientSession& session) {
+    bool over = session.writeQueue.size() > m_limits.maxQueuedMessages || session.queuedBytes > m_limits.maxQueuedBytes;
+    if (!over) {
+        session.overLimitSince = 0;
+        return;
+    }
+    
+    uint64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (session.overLimitSince == 0) {
+        session.overLimitSince = now;
+    }
+    
+    bool hardLimit = session.queuedBytes > m_limits.maxQueuedBytes * HARD_LIMIT_FACTOR;
+    if (!hardLimit && now - session.overLimitSince < m_limits.evictAfterMs) {
+        return;
+    }
+    
+    LOG_WARN("WebSocket", "Evicting client {}: {} messages ({} bytes) queued for {}ms", session.id.load(std::memory_order_relaxed),
+             session.writeQueue.size(), session.queuedBytes, now - session.overLimitSince);
+    session.evicting = true;
+    session.closeReason = "outbound queue limit";
+    session.writeQueue.clear();
+    session.queuedBytes = 0;
+    session.queuedLatestOnly = 0;
+    m_evictions.fetch_add(1, std::memory_order_relaxed);
+}
+
+void WebSocketServer::enqueue(const SessionPtr& session, const SharedBuffer& buffer) {
+    if (session->closed) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(session->mutex);
+        if (session->evicting) {
+            return;
+        }
+        
+        auto& queue = session->writeQueue;
+        bool latestOnly = buffer->delivery() == Delivery::LatestOnly;
+        if (latestOnly && m_limits.supersedeState && session->queuedLatestOnly > 0) {
+            // The newer state replaces the queued one; it goes to the back, after anything reliable sent meanwhile
+            auto stale = std::find_if(queue.begin(), queue.end(), [](const SharedBuffer& queued) {
+                return queued->delivery() == Delivery::LatestOnly;
+            });
+            if (stale != queue.end()) {
+                session->queuedBytes -= (*stale)->length();
+                session->queuedLatestOnly--;
+                session->supersededFrames++;
+                queue.erase(stale);
+                m_supersededFrames.fetch_add(1, std::memory_order_relaxed);
             }
-            lws_callback_on_writable(wsi);
         }
+        
+        queue.push_back(buffer);
+        session->queuedBytes += buffer->length();
+        if (latestOnly) {
+            session->queuedLatestOnly++;
+        }
+        checkLimitsLocked(*session);
+    }
+    requestWritable(session); // Also wakes the owning thread to close an evicted session
+}
+
+void WebSocketServer::send(uint64_t clientId, const std::string& message) {
+    if (SessionPtr session = m_clients.find(clientId)) {
+        enqueue(session, makeBuffer(message));
+    }
+}
+
+void WebSocketServer::sendBinary(uint64_t clientId, const std::string& data) {
+    if (SessionPtr session = m_clients.find(clientId)) {
+        enqueue(session, makeBuffer(data, true));
     }
 }
 
+void WebSocketServer::send(uint64_t clientId, const SharedBuffer& buffer) {
+    if (SessionPtr session = m_clients.find(clientId)) {
+        enqueue(session, buffer);
+    }
+}
+
+void WebSocketServer::broadcast(const std::string& message) {
+    SharedBuffer outbound = makeBuffer(message); // Encoded once for every recipient
+    m_clients.forEach([&](const SessionPtr& session) {
+        enqueue(session, outbound);
+    });
+}
+
 void WebSocketServer::broadcastToRoom(const std::string& roomId, const std::string& message) {
-    std::lock_guard<std::recursive_mutex> lock(m_clientMapMutex);
-    for (auto& pair : m_idToWsi) {
-        struct lws* wsi = pair.second;
-        PerSessionData* pss = (PerSessionData*)lws_wsi_user(wsi);
-        if (pss && pss->initialized && pss->roomId == roomId) {
-            {
-                std::lock_guard<std::mutex> lock(pss->queueMutex);
-                pss->writeQueue.push_back(message);
-            }
-            lws_callback_on_writable(wsi);
+    RoomHandle room = findRoom(roomId);
+    if (room != INVALID_ROOM) {
+        broadcastToRoom(room, message);
+    }
+}
+
+void WebSocketServer::broadcastToRoom(RoomHandle room, const std::string& message) {
+    SharedBuffer outbound = makeBuffer(message);
+    std::shared_lock<std::shared_mutex> lock(m_roomsMutex);
+    auto it = m_roomMembers.find(room);
+    if (it == m_roomMembers.end()) {
+        return;
+    }
+    for (const SessionPtr& session : it->second) {
+        enqueue(session, outbound);
+    }
+}
+
+void WebSocketServer::broadcastToRoom(RoomHandle room, const SharedBuffer& outbound, Protocol protocol) {
+    std::shared_lock<std::shared_mutex> lock(m_roomsMutex);
+    auto it = m_roomMembers.find(room);
+    if (it == m_roomMembers.end()) {
+        return;
+    }
+    for (const SessionPtr& session : it->second) {
+        if (session->protocol == protocol) {
+            enqueue(session, outbound);
         }
     }
 }
 
+WebSocketServer::RoomHandle WebSocketServer::internRoom(const std::string& roomId) {
+    {
+        std::shared_lock<std::shared_mutex> lock(m_roomsMutex);
+        auto it = m_roomHandles.find(roomId);
+        if (it != m_roomHandles.end()) {
+            return it->second;
+        }
+    }
+    
+    std::unique_lock<std::shared_mutex> lock(m_roomsMutex);
+    auto inserted = m_roomHandles.emplace(roomId, m_nextRoomHandle);
+    if (inserted.second) {
+        m_nextRoomHandle++; // Handles are never reused, so a stale handle just finds no room
+    }
+    return inserted.first->second;
+}
+
+void WebSocketServer::releaseRoom(const std::string& roomId) {
+    if (roomId.empty()) {
+        return; // The lobby is permanent
+    }
+    
+    std::unique_lock<std::shared_mutex> lock(m_roomsMutex);
+    auto handleIt = m_roomHandles.find(roomId);
+    if (handleIt == m_roomHandles.end()) {
+        return;
+    }
+    RoomHandle room = handleIt->second;
+    
+    auto membersIt = m_roomMembers.find(room);
+    if (membersIt != m_roomMembers.end()) {
+        for (const SessionPtr& session : membersIt->second) {
+            auto& rooms = session->rooms;
+            rooms.erase(std::remove(rooms.begin(), rooms.end(), room), rooms.end());
+        }
+        m_roomMembers.erase(membersIt);
+    }
+    m_roomHandles.erase(handleIt);
+}
+
+void WebSocketServer::joinRoom(uint64_t clientId, const std::string& roomId) {
+    SessionPtr session = m_clients.find(clientId);
+    if (!session) return;
+    
+    RoomHandle room = internRoom(roomId);
+    std::unique_lock<std::shared_mutex> lock(m_roomsMutex);
+    addToRoomLocked(session, room);
+}
+
+void WebSocketServer::leaveRoom(uint64_t clientId, const std::string& roomId) {
+    SessionPtr session = m_clients.find(clientId);
+    RoomHandle room = findRoom(roomId);
+    if (!session || room == INVALID_ROOM) return;
+    
+    std::unique_lock<std::shared_mutex> lock(m_roomsMutex);
+    removeFromRoomLocked(session, room);
+}
+
 void WebSocketServer::setClientRoom(uint64_t clientId, const std::string& roomId) {
-    std::lock_guard<std::recursive_mutex> lock(m_clientMapMutex);
-    auto it = m_idToWsi.find(clientId);
-    if (it != m_idToWsi.end()) {
-        struct lws* wsi = it->second;
-        PerSessionData* pss = (PerSessionData*)lws_wsi_user(wsi);
-        if (pss) {
-            pss->roomId = roomId;
+    SessionPtr session = m_clients.find(clientId);
+    if (!session) return;
+    
+    RoomHandle room = internRoom(roomId);
+    std::unique_lock<std::shared_mutex> lock(m_roomsMutex);
+    while (!session->rooms.empty()) {
+        removeFromRoomLocked(session, session->rooms.back());
+    }
+    addToRoomLocked(session, room);
+}
+
+bool WebSocketServer::rebindClient(uint64_t clientId, uint64_t newId) {
+    SessionPtr session = m_clients.find(clientId);
+    if (!session || session->closed || clientId == newId) {
+        return false;
+    }
+    
+    SessionPtr previous = m_clients.find(newId);
+    {
+        std::unique_lock<std::shared_mutex> lock(m_roomsMutex);
+        if (previous) {
+            while (!previous->rooms.empty()) {
+                removeFromRoomLocked(previous, previous->rooms.back());
+            }
+        }
+        m_clients.erase(clientId);
+        {
+            std::lock_guard<std::mutex> sessionLock(session->mutex);
+            session->id.store(newId, std::memory_order_relaxed);
+        }
+        m_clients.insert(newId, session);
+    }
+    
+    if (previous) {
+        {
+            std::lock_guard<std::mutex> lock(previous->mutex);
+            previous->id.store(0, std::memory_order_relaxed);
+            previous->evicting = true;
+            previous->closeReason = "session resumed on another connection";
+            previous->writeQueue.clear();
+            previous->queuedBytes = 0;
+            previous->queuedLatestOnly = 0;
         }
+        requestWritable(previous); // Its owning thread closes it
+    }
+    
+    LOG_INFO("WebSocket", "Client {} resumed as {}", clientId, newId);
+    return true;
+}
+
+WebSocketServer::RoomHandle WebSocketServer::findRoom(const std::string& roomId) const {
+    std::shared_lock<std::shared_mutex> lock(m_roomsMutex);
+    auto it = m_roomHandles.find(roomId);
+    return it != m_roomHandles.end() ? it->second : INVALID_ROOM;
+}
+
+void WebSocketServer::addToRoomLocked(const SessionPtr& session, RoomHandle room) {
+    if (session->closed || std::find(session->rooms.begin(), session->rooms.end(), room) != session->rooms.end()) {
+        return;
+    }
+    session->rooms.push_back(room);
+    m_roomMembers[room].push_back(session);
+}
+
+void WebSocketServer::removeFromRoomLocked(const SessionPtr& session, RoomHandle room) {
+    auto& rooms = session->rooms;
+    auto roomIt = std::find(rooms.begin(), rooms.end(), room);
+    if (roomIt == rooms.end()) {
+        return;
+    }
+    rooms.erase(roomIt);
+    
+    auto membersIt = m_roomMembers.find(room);
+    if (membersIt == m_roomMembers.end()) {
+        return;
+    }
+    auto& members = membersIt->second;
+    auto memberIt = std::find(members.begin(), members.end(), session);
+    if (memberIt != members.end()) {
+        *memberIt = std::move(members.back()); // Order within a room does not matter
+        members.pop_back();
+    }
+    if (members.empty() && room != LOBBY_ROOM) {
+        m_roomMembers.erase(membersIt);
     }
 }
 
+bool WebSocketServer::isConnected(uint64_t clientId) const {
+    SessionPtr session = m_clients.find(clientId);
+    return session && !session->closed;
+}
+
 uint64_t WebSocketServer::getClientId(struct lws* wsi) const {
-    std::lock_guard<std::recursive_mutex> lock(m_clientMapMutex);
-    auto it = m_wsiToId.find(wsi);
-    return (it != m_wsiToId.end()) ? it->second : 0;
+    PerSessionData* pss = (PerSessionData*)lws_wsi_user(wsi);
+    return (pss && pss->initialized && pss->session) ? pss->session->id.load(std::memory_order_relaxed) : 0;
+}
+
+std::vector<uint64_t> WebSocketServer::getRoomClientIds(RoomHandle room, Protocol protocol) const {
+    std::vector<uint64_t> ids;
+    std::shared_lock<std::shared_mutex> lock(m_roomsMutex);
+    auto it = m_roomMembers.find(room);
+    if (it != m_roomMembers.end()) {
+        for (const SessionPtr& session : it->second) {
+            if (session->protocol == protocol) {
+                ids.push_back(session->id.load(std::memory_order_relaxed));
+            }
+        }
+    }
+    return ids;
+}
+
+std::vector<WebSocketServer::QueueStats> WebSocketServer::getQueueStats() const {
+    std::vector<QueueStats> stats;
+    m_clients.forEach([&](const SessionPtr& session) {
+        std::lock_guard<std::mutex> lock(session->mutex);
+        stats.push_back(QueueStats{session->id.load(std::memory_order_relaxed), session->writeQueue.size(), session->queuedBytes, session->supersededFrames});
+    });
+    return stats;
 }
@@ -1 +1,229 @@
+#pragma once
 
+#include <string>
+#include <memory>
+#include <functional>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <atomic>
+#include <cstdint>
+#include "ClientRegistry.h"
+#include "Metrics.h"
+
+struct lws;
+struct lws_context;
+
+class WebSocketServer {
+public:
+    using ConnectCallback = std::function<void(uint64_t)>;
+    using DisconnectCallback = std::function<void(uint64_t)>;
+    // Frame payload in the receive buffer: valid only for the call, and writable so
+    // parsers can decode in place
+    using MessageCallback = std::function<void(uint64_t, char*, size_t)>;
+    using MetricsCallback = std::function<std::string()>; // Body of GET /metrics
+    using IdAllocator = std::function<uint64_t()>;        // Returns 0 to refuse the connection
+    
+    // Interned room ID; the lobby ("") is always LOBBY_ROOM
+    using RoomHandle = uint32_t;
+    static constexpr RoomHandle LOBBY_ROOM = 0;
+    static constexpr RoomHandle INVALID_ROOM = UINT32_MAX;
+    
+    // Negotiated WebSocket subprotocol of a session
+    enum class Protocol {
+        Json,   // "game-websocket": every message is a JSON text frame
+        Binary  // "game-binary": state updates are binary delta frames, everything else stays JSON
+    };
+    
+    enum class Delivery {
+        Reliable,  // Always delivered, in order
+        LatestOnly // State updates: a queued frame is dropped when a newer one arrives
+    };
+    
+    // Outbound frame encoded once and shared by every session it is queued on.
+    // Immutable once built: lws_write writes the frame header into the LWS_PRE bytes
+    // in front of the payload, so the writing service thread copies it behind its
+    // own headroom instead (see ServiceThread::writeScratch).
+    class OutboundBuffer {
+    public:
+        OutboundBuffer(const char* data, size_t length, bool binary, Delivery delivery = Delivery::Reliable);
+        
+        const unsigned char* payload() const { return m_storage.data(); }
+        size_t length() const { return m_storage.size(); }
+        bool isBinary() const { return m_binary; }
+        Delivery delivery() const { return m_delivery; }
+    
+    private:
+        std::vector<unsigned char> m_storage;
+        bool m_binary;
+        Delivery m_delivery;
+    };
+    using SharedBuffer = std::shared_ptr<const OutboundBuffer>;
+    
+    static SharedBuffer makeBuffer(const std::string& data, bool binary = false, Delivery delivery = Delivery::Reliable);
+    
+    // Per-session outbound queue policy. A session over either cap keeps receiving
+    // reliable frames, but is disconnected if it stays over for evictAfterMs, or at
+    // once past HARD_LIMIT_FACTOR times the byte cap.
+    struct OutboundLimits {
+        size_t maxQueuedMessages = 256;
+        size_t maxQueuedBytes = 1024 * 1024;
+        bool supersedeState = true;    // Keep at most one queued LatestOnly frame per session
+        uint64_t evictAfterMs = 5000;
+        int maxFramesPerWrite = 16;    // Frames written per writable callback while the socket takes them
+    };
+    static const size_t HARD_LIMIT_FACTOR = 4;
+    
+    struct QueueStats {
+        uint64_t clientId;
+        size_t queuedMessages;
+        size_t queuedBytes;
+        uint64_t supersededFrames;
+    };
+    
+    // Connection state shared by the owning service thread and every thread sending
+    // to it. Held by shared_ptr so a sender that looked it up can finish enqueuing
+    // after the connection closes; wsi is only dereferenced on the owning thread.
+    struct ClientSession {
+        std::atomic<uint64_t> id{0}; // Rebound on session resumption while other threads read it
+        Protocol protocol = Protocol::Json;
+        int serviceThread = 0; // Index of the lws service thread that owns this connection
+        struct lws* wsi = nullptr;
+        std::atomic<bool> closed{false};
+        
+        std::mutex mutex; // Guards the write queue and its accounting
+        std::deque<SharedBuffer> writeQueue;
+        size_t queuedBytes = 0;
+        size_t queuedLatestOnly = 0;
+        uint64_t overLimitSince = 0; // ms, 0 while within limits
+        uint64_t supersededFrames = 0;
+        bool evicting = false;       // Queue dropped; the owning thread closes the connection
+        const char* closeReason = nullptr; // Sent in the close frame when evicting
+        
+        std::vector<RoomHandle> rooms; // Guarded by the server's room index lock
+    };
+    using SessionPtr = std::shared_ptr<ClientSession>;
+    
+    // Per-connection storage, allocated by libwebsockets and constructed in place
+    struct PerSessionData {
+        bool initialized = true;
+        SessionPtr session;
+        std::string partialMessage; // Reassembly buffer, only used for fragmented messages
+        std::string httpBody;       // HTTP response being written
+        size_t httpSent = 0;
+    };
+    
+    WebSocketServer(int port, int serviceThreads = 1);
+    ~WebSocketServer();
+    
+    void run();
+    void stop(); // Async-signal-safe; run() returns within one service poll, even if called before run()
+    
+    void setOnConnect(ConnectCallback callback);
+    void setOnDisconnect(DisconnectCallback callback);
+    void setOnMessage(MessageCallback callback);
+    void setOnBinaryMessage(MessageCallback callback);
+    void setOnMetrics(MetricsCallback callback); // Serves GET /metrics on the WebSocket port
+    void setIdAllocator(IdAllocator allocator);  // Client IDs come from here instead of a counter; call before run()
+    
+    // Called from the libwebsockets callback
+    bool onConnect(struct lws* wsi, Protocol protocol); // False refuses the connection
+    void onDisconnect(struct lws* wsi);
+    void onMessage(struct lws* wsi, char* data, size_t length);
+    void onBinaryMessage(struct lws* wsi, char* data, size_t length);
+    void onWakeup(); // Runs on a service thread after lws_cancel_service
+    int onWritable(struct lws* wsi, ClientSession& session); // -1 closes the connection
+    bool renderMetrics(std::string& body); // False if no metrics callback is set
+    
+    void setOutboundLimits(const OutboundLimits& limits); // Call before run()
+    
+    void send(uint64_t clientId, const std::string& message);
+    void sendBinary(uint64_t clientId, const std::string& data);
+    void send(uint64_t clientId, const SharedBuffer& buffer); // Pre-encoded, shareable across clients
+    void broadcast(const std::string& message);
+    void broadcastToRoom(const std::string& roomId, const std::string& message);
+    void broadcastToRoom(RoomHandle room, const std::string& message);
+    void broadcastToRoom(RoomHandle room, const SharedBuffer& buffer, Protocol protocol); // Only sessions on the given protocol
+    
+    // Room membership. New connections start in the lobby; a client may be in several rooms.
+    RoomHandle internRoom(const std::string& roomId); // Stable handle, created on first use
+    void releaseRoom(const std::string& roomId);      // Drops the room and its memberships
+    void joinRoom(uint64_t clientId, const std::string& roomId);
+    void leaveRoom(uint64_t clientId, const std::string& roomId);
+    void setClientRoom(uint64_t clientId, const std::string& roomId); // Leave all rooms, join one
+    
+    // Session resumption: the connection known as clientId answers to newId from now
+    // on. A connection still holding newId (the dropped socket of a resumed session)
+    // is closed without reporting newId as disconnected. Call from a message callback
+    // of clientId, i.e. on its owning service thread.
+    bool rebindClient(uint64_t clientId, uint64_t newId);
+    
+    uint64_t getClientId(struct lws* wsi) const;
+    bool isConnected(uint64_t clientId) const;
+    std::vector<uint64_t> getRoomClientIds(RoomHandle room, Protocol protocol) const;
+    
+    // Outbound queue metrics
+    std::vector<QueueStats> getQueueStats() const;
+    uint64_t getSupersededFrameCount() const { return m_supersededFrames.load(std::memory_order_relaxed); }
+    uint64_t getEvictionCount() const { return m_evictions.load(std::memory_order_relaxed); }
+    
+    // Traffic, counted per service thread
+    size_t getClientCount() const { return m_clients.size(); }
+    uint64_t getFramesIn() const { return m_framesIn.value(); }
+    uint64_t getBytesIn() const { return m_bytesIn.value(); }
+    uint64_t getFramesOut() const { return m_framesOut.value(); }
+    uint64_t getBytesOut() const { return m_bytesOut.value(); }
+
+private:
+    int m_port;
+    int m_serviceThreadCount;
+    std::atomic<bool> m_stopping;
+    struct lws_context* context;
+    std::atomic<uint64_t> m_nextClientId;
+    
+    // lws_callback_on_writable may only be called on the service thread that owns
+    // the connection. Other threads park the session with its owning thread and
+    // wake the service loops; each thread requests writes for its own list.
+    struct ServiceThread {
+        std::thread thread;
+        std::mutex pendingMutex;
+        std::vector<SessionPtr> pendingWritable;
+        std::vector<unsigned char> writeScratch; // LWS_PRE + frame being written; this thread only
+    };
+    std::vector<std::unique_ptr<ServiceThread>> m_serviceThreads;
+    
+    ClientRegistry<ClientSession> m_clients;
+    OutboundLimits m_limits;
+    std::atomic<uint64_t> m_supersededFrames;
+    std::atomic<uint64_t> m_evictions;
+    Metrics::Counter m_framesIn;
+    Metrics::Counter m_bytesIn;
+    Metrics::Counter m_framesOut;
+    Metrics::Counter m_bytesOut;
+    
+    // Room index: interned names and member lists, so room fan-out is O(members).
+    // Membership changes are rare (match start/end, connect/disconnect) next to
+    // broadcasts, which only take the lock shared.
+    std::unordered_map<std::string, RoomHandle> m_roomHandles;
+    std::unordered_map<RoomHandle, std::vector<SessionPtr>> m_roomMembers;
+    RoomHandle m_nextRoomHandle;
+    mutable std::shared_mutex m_roomsMutex;
+    
+    ConnectCallback m_onConnect;
+    DisconnectCallback m_onDisconnect;
+    MessageCallback m_onMessage;
+    MessageCallback m_onBinaryMessage;
+    MetricsCallback m_onMetrics;
+    IdAllocator m_idAllocator;
+    
+    void enqueue(const SessionPtr& session, const SharedBuffer& buffer);
+    void checkLimitsLocked(ClientSession& session);
+    void requestWritable(const SessionPtr& session);
+    RoomHandle findRoom(const std::string& roomId) const;
+    void addToRoomLocked(const SessionPtr& session, RoomHandle room);
+    void removeFromRoomLocked(const SessionPtr& session, RoomHandle room);
+    void serviceLoop(int threadIndex);
+};
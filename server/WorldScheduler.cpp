@@ -0,0 +1,191 @@
+#include "WorldScheduler.h"
+#include "GameStateManager.h"
+#include "Log.h"
+#include <algorithm>
+
+WorldScheduler::WorldScheduler(size_t workerCount, std::chrono::microseconds spinWindow)
+    : m_running(false), m_spinWindow(spinWindow), m_epoch(std::chrono::steady_clock::now()) {
+    workerCount = std::max<size_t>(1, workerCount);
+    for (size_t i = 0; i < workerCount; ++i) {
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+}
+
+WorldScheduler::~WorldScheduler() {
+    stop();
+}
+
+void WorldScheduler::start() {
+    if (m_running) {
+        return;
+    }
+    m_running = true;
+    for (auto& worker : m_workers) {
+        worker->thread = std::thread(&WorldScheduler::workerLoop, this, worker.get());
+    }
+    LOG_INFO("WorldScheduler", "Started {} tick workers", m_workers.size());
+}
+
+void WorldScheduler::stop() {
+    m_running = false;
+    for (auto& worker : m_workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+}
+
+void WorldScheduler::addWorld(const std::string& worldId, std::shared_ptr<GameStateManager> world) {
+    std::lock_guard<std::mutex> lock(m_worldsMutex);
+    if (m_worlds.count(worldId)) {
+        return;
+    }
+    
+    auto scheduled = std::make_shared<ScheduledWorld>();
+    scheduled->world = world;
+    scheduled->period = std::chrono::nanoseconds(1000000000 / world->getTickRate());
+    scheduled->nextTick = static_cast<uint64_t>((std::chrono::steady_clock::now() - m_epoch) / scheduled->period) + 1;
+    
+    // Pin to the worker currently ticking the fewest worlds
+    size_t target = 0;
+    size_t fewest = SIZE_MAX;
+    for (size_t i = 0; i < m_workers.size(); ++i) {
+        std::lock_guard<std::mutex> workerLock(m_workers[i]->mutex);
+        if (m_workers[i]->worlds.size() < fewest) {
+            fewest = m_workers[i]->worlds.size();
+            target = i;
+        }
+    }
+    
+    {
+        std::lock_guard<std::mutex> workerLock(m_workers[target]->mutex);
+        m_workers[target]->worlds.push_back(scheduled);
+    }
+    m_worlds[worldId] = WorldEntry{scheduled, target};
+}
+
+void WorldScheduler::removeWorld(const std::string& worldId) {
+    std::lock_guard<std::mutex> lock(m_worldsMutex);
+    auto it = m_worlds.find(worldId);
+    if (it == m_worlds.end()) {
+        return;
+    }
+    
+    Worker* worker = m_workers[it->second.workerIndex].get();
+    {
+        std::lock_guard<std::mutex> workerLock(worker->mutex);
+        auto& worlds = worker->worlds;
+        worlds.erase(std::remove(worlds.begin(), worlds.end(), it->second.scheduled), worlds.end());
+    }
+    m_worlds.erase(it);
+}
+
+std::shared_ptr<GameStateManager> WorldScheduler::getWorld(const std::string& worldId) const {
+    std::lock_guard<std::mutex> lock(m_worldsMutex);
+    auto it = m_worlds.find(worldId);
+    return it != m_worlds.end() ? it->second.scheduled->world : nullptr;
+}
+
+size_t WorldScheduler::getWorldCount() const {
+    std::lock_guard<std::mutex> lock(m_worldsMutex);
+    return m_worlds.size();
+}
+
+void WorldScheduler::forEachWorld(const std::function<void(const GameStateManager&)>& fn) const {
+    std::lock_guard<std::mutex> lock(m_worldsMutex);
+    for (const auto& entry : m_worlds) {
+        fn(*entry.second.scheduled->world);
+    }
+}
+
+TickStats WorldScheduler::getStats() const {
+    TickStats stats;
+    for (const auto& worker : m_workers) {
+        stats.ticks += worker->ticks.load(std::memory_order_relaxed);
+        stats.catchUpTicks += worker->catchUpTicks.load(std::memory_order_relaxed);
+        stats.skippedTicks += worker->skippedTicks.load(std::memory_order_relaxed);
+        stats.overruns += worker->overruns.load(std::memory_order_relaxed);
+        stats.jitterSamples += worker->jitterSamples.load(std::memory_order_relaxed);
+        stats.jitterTotalUs += worker->jitterTotalUs.load(std::memory_order_relaxed);
+        stats.jitterMaxUs = std::max(stats.jitterMaxUs, worker->jitterMaxUs.load(std::memory_order_relaxed));
+    }
+    return stats;
+}
+
+std::chrono::steady_clock::time_point WorldScheduler::deadline(const ScheduledWorld& scheduled, uint64_t tick) const {
+    return m_epoch + scheduled.period * tick;
+}
+
+void WorldScheduler::waitUntil(std::chrono::steady_clock::time_point deadline) const {
+    // Sleep overshoots by up to a scheduler quantum, so spin through the last stretch
+    auto wake = deadline - m_spinWindow;
+    if (std::chrono::steady_clock::now() < wake) {
+        std::this_thread::sleep_until(wake);
+    }
+    while (std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+}
+
+void WorldScheduler::runDueTicks(Worker* worker, ScheduledWorld& scheduled, std::chrono::steady_clock::time_point now) {
+    if (now < deadline(scheduled, scheduled.nextTick)) {
+        return;
+    }
+    
+    // Latest tick whose deadline has passed
+    uint64_t due = static_cast<uint64_t>((now - m_epoch) / scheduled.period);
+    uint64_t behind = due - scheduled.nextTick + 1;
+    if (behind > MAX_CATCHUP_STEPS) {
+        uint64_t skipped = behind - MAX_CATCHUP_STEPS;
+        scheduled.nextTick += skipped;
+        worker->skippedTicks.fetch_add(skipped, std::memory_order_relaxed);
+    }
+    
+    // Jitter is only meaningful for a tick that started on schedule
+    if (scheduled.nextTick == due) {
+        auto lateness = std::chrono::steady_clock::now() - deadline(scheduled, due);
+        uint64_t jitterUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(lateness).count());
+        worker->jitterSamples.fetch_add(1, std::memory_order_relaxed);
+        worker->jitterTotalUs.fetch_add(jitterUs, std::memory_order_relaxed);
+        if (jitterUs > worker->jitterMaxUs.load(std::memory_order_relaxed)) {
+            worker->jitterMaxUs.store(jitterUs, std::memory_order_relaxed);
+        }
+    }
+    
+    uint64_t steps = 0;
+    for (; scheduled.nextTick <= due; ++scheduled.nextTick) {
+        scheduled.world->tick(scheduled.nextTick);
+        steps++;
+    }
+    worker->ticks.fetch_add(steps, std::memory_order_relaxed);
+    worker->catchUpTicks.fetch_add(steps - 1, std::memory_order_relaxed);
+    
+    if (std::chrono::steady_clock::now() >= deadline(scheduled, scheduled.nextTick)) {
+        worker->overruns.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void WorldScheduler::workerLoop(Worker* worker) {
+    std::vector<std::shared_ptr<ScheduledWorld>> worlds;
+    
+    while (m_running) {
+        // Tick a copy so worlds can be added or removed while this worker runs;
+        // a removed world stays alive until its last tick finishes
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            worlds = worker->worlds;
+        }
+        
+        auto next = std::chrono::steady_clock::now() + IDLE_WAIT;
+        for (const auto& scheduled : worlds) {
+            next = std::min(next, deadline(*scheduled, scheduled->nextTick));
+        }
+        waitUntil(next);
+        
+        auto now = std::chrono::steady_clock::now();
+        for (const auto& scheduled : worlds) {
+            runDueTicks(worker, *scheduled, now);
+        }
+        worlds.clear();
+    }
+}
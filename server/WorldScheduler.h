@@ -0,0 +1,97 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+
+class GameStateManager;
+
+// Tick timing counters, summed over all workers
+struct TickStats {
+    uint64_t ticks = 0;         // World ticks run
+    uint64_t catchUpTicks = 0;  // Ticks run back to back because a world had fallen behind
+    uint64_t skippedTicks = 0;  // Ticks dropped when a world fell more than MAX_CATCHUP_STEPS behind
+    uint64_t overruns = 0;      // Ticks that finished after the world's next deadline
+    uint64_t jitterSamples = 0; // On-time ticks, measured from deadline to start
+    uint64_t jitterTotalUs = 0;
+    uint64_t jitterMaxUs = 0;
+};
+
+// Ticks isolated game worlds (the lobby plus one per match) on a pool of worker
+// threads. Each world is pinned to the least loaded worker when added and ticked
+// at its own rate (GameStateManager::getTickRate()).
+//
+// Ticks run on absolute deadlines: tick n of a world is due n periods after the
+// scheduler's epoch, so wake-up latency never accumulates into drift and tick
+// numbers mean the same moment in every world with the same rate. Workers sleep
+// until shortly before the next deadline and spin the rest of the way. A world
+// that falls behind runs its missed ticks back to back (fixed timestep), up to
+// MAX_CATCHUP_STEPS per wake-up; anything older is skipped and counted.
+class WorldScheduler {
+public:
+    static constexpr uint64_t MAX_CATCHUP_STEPS = 4;
+    
+    // spinWindow: how long before a deadline to stop sleeping and spin; 0 sleeps all the way
+    WorldScheduler(size_t workerCount, std::chrono::microseconds spinWindow = std::chrono::microseconds(200));
+    ~WorldScheduler();
+    
+    void start();
+    void stop();
+    
+    void addWorld(const std::string& worldId, std::shared_ptr<GameStateManager> world);
+    void removeWorld(const std::string& worldId);
+    std::shared_ptr<GameStateManager> getWorld(const std::string& worldId) const;
+    size_t getWorldCount() const;
+    void forEachWorld(const std::function<void(const GameStateManager&)>& fn) const; // Holds the world list lock
+    
+    TickStats getStats() const;
+
+private:
+    // Schedule state is only touched by the owning worker once the world is added
+    struct ScheduledWorld {
+        std::shared_ptr<GameStateManager> world;
+        std::chrono::nanoseconds period;
+        uint64_t nextTick;
+    };
+    
+    struct Worker {
+        std::thread thread;
+        std::mutex mutex;
+        std::vector<std::shared_ptr<ScheduledWorld>> worlds;
+        
+        // Written by the worker only
+        std::atomic<uint64_t> ticks{0};
+        std::atomic<uint64_t> catchUpTicks{0};
+        std::atomic<uint64_t> skippedTicks{0};
+        std::atomic<uint64_t> overruns{0};
+        std::atomic<uint64_t> jitterSamples{0};
+        std::atomic<uint64_t> jitterTotalUs{0};
+        std::atomic<uint64_t> jitterMaxUs{0};
+    };
+    
+    struct WorldEntry {
+        std::shared_ptr<ScheduledWorld> scheduled;
+        size_t workerIndex;
+    };
+    
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::unordered_map<std::string, WorldEntry> m_worlds;
+    mutable std::mutex m_worldsMutex;
+    
+    std::atomic<bool> m_running;
+    std::chrono::nanoseconds m_spinWindow;
+    std::chrono::steady_clock::time_point m_epoch;
+    static constexpr std::chrono::milliseconds IDLE_WAIT{10}; // Worker with no worlds
+    
+    std::chrono::steady_clock::time_point deadline(const ScheduledWorld& scheduled, uint64_t tick) const;
+    void waitUntil(std::chrono::steady_clock::time_point deadline) const;
+    void runDueTicks(Worker* worker, ScheduledWorld& scheduled, std::chrono::steady_clock::time_point now);
+    void workerLoop(Worker* worker);
+};
@@ -1,32 +1,71 @@
 #include "GameServer.h"
-#include <iostream>
+#include "Log.h"
 #include <signal.h>
 
-GameServer* g_server = nullptr;
+GameServer* g_server = nullptr; // Set before the signal handlers are installed
 
-void signalHandler(int signum) {
-    if (g_server) {
-        std::cout << "Shutting down server..." << std::endl;
-        g_server->stop();
-    }
-    exit(signum);
+void signalHandler(int) {
+    // Logging, locks and joins are not async-signal-safe; only ask run() to return
+    // and shut down on the main thread
+    g_server->requestStop();
 }
 
 int main(int argc, char* argv[]) {
-    signal(SIGINT, signalHandler);
-    signal(SIGTERM, signalHandler);
+    Log::start();
     
     int port = 8080;
     if (argc > 1) {
         port = std::stoi(argv[1]);
     }
     
-    g_server = new GameServer(port);
+    size_t worldThreads = 0; // One per hardware thread
+    if (argc > 2) {
+        worldThreads = std::stoul(argv[2]);
+    }
+    
+    int serviceThreads = 1; // libwebsockets network I/O threads
+    if (argc > 3) {
+        serviceThreads = std::stoi(argv[3]);
+    }
+    
+    int tickRate = 0; // World ticks per second, 0 = default
+    if (argc > 4) {
+        tickRate = std::stoi(argv[4]);
+    }
+    
+    int matchmakingIntervalMs = 0; // Between matchmaking passes, 0 = default
+    if (argc > 5) {
+        matchmakingIntervalMs = std::stoi(argv[5]);
+    }
+    
+    int worldSize = 0; // Side of each world in cells, 0 = default (8)
+    if (argc > 6) {
+        worldSize = std::stoi(argv[6]);
+    }
+    
+    int reconnectGraceMs = 0; // How long a dropped session can be resumed, 0 = default, negative = never
+    if (argc > 7) {
+        reconnectGraceMs = std::stoi(argv[7]);
+    }
+    
+    std::string recordDir; // Record every world's actions here for GameServerReplay, "" = off
+    if (argc > 8) {
+        recordDir = argv[8];
+    }
+    
+    g_server = new GameServer(port, worldThreads, serviceThreads, tickRate, matchmakingIntervalMs, worldSize,
+                              reconnectGraceMs, recordDir);
+    
+    signal(SIGINT, signalHandler);
+    signal(SIGTERM, signalHandler);
     
-    std::cout << "Starting game server on port " << port << std::endl;
+    LOG_INFO("Server", "Starting game server on port {}", port);
     g_server->run();
     
+    LOG_INFO("Server", "Shutting down server...");
+    g_server->stop();
     delete g_server;
+    Log::stop();
     return 0;
 }
 